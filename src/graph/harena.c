@@ -0,0 +1,145 @@
+#include "harena.h"
+
+/**
+ * Size of a block of an arena, allocations bigger than this get a block of their own
+ */
+#define HARENA_BLOCK_SIZE ((uint64_t) 4 << 20)
+
+/**
+ * Alignment of the allocations
+ */
+#define HARENA_ALIGNMENT 8
+
+/**
+ *  Allocate a block of at least size bytes, which is not linked to an arena yet
+ */
+static harena_block*
+create_block(uint64_t size)
+{
+    if (size < HARENA_BLOCK_SIZE)
+    {
+        size = HARENA_BLOCK_SIZE;
+    }
+
+    harena_block* b = malloc(sizeof(harena_block) + size);
+    assert(b != NULL && "Could not allocate arena block");
+    b->size = size;
+    b->used = 0;
+
+    return b;
+}
+
+/**
+ *  Start a new block of at least size bytes in arena a
+ */
+static void
+add_block(harena* a, uint64_t size)
+{
+    harena_block* b = create_block(size);
+    size = b->size;
+
+    // The block is owned by harena_alloc, harena_alloc_concurrent sees it as full
+    b->used = size;
+    b->next = a->blocks;
+
+    a->blocks = b;
+    a->cursor = b->data;
+    a->end = b->data + size;
+    a->size += size;
+}
+
+/**
+ * @return An arena without blocks, the first one is allocated on first use
+ */
+harena*
+harena_create()
+{
+    harena* a = malloc(sizeof(harena));
+    a->blocks = NULL;
+    a->cursor = NULL;
+    a->end = NULL;
+    a->size = 0;
+
+    return a;
+}
+
+/**
+ * @param a An initialized arena
+ * @param size Number of bytes to allocate
+ * @return Pointer to size bytes of uninitialized memory, valid until a is destroyed
+ */
+void*
+harena_alloc(harena* a, uint64_t size)
+{
+    size = (size + HARENA_ALIGNMENT - 1) & ~((uint64_t) HARENA_ALIGNMENT - 1);
+
+    if ((uint64_t) (a->end - a->cursor) < size)
+    {
+        add_block(a, size);
+    }
+
+    void* p = a->cursor;
+    a->cursor += size;
+
+    return p;
+}
+
+/**
+ * @param a An initialized arena
+ * @param size Number of bytes to allocate
+ * @return Pointer to size bytes of uninitialized memory, valid until a is destroyed
+ *
+ * Allocations of concurrent threads never overlap, but harena_alloc must not run at the same time
+ */
+void*
+harena_alloc_concurrent(harena* a, uint64_t size)
+{
+    size = (size + HARENA_ALIGNMENT - 1) & ~((uint64_t) HARENA_ALIGNMENT - 1);
+
+    for (;;)
+    {
+        harena_block* b = __atomic_load_n(&a->blocks, __ATOMIC_ACQUIRE);
+
+        if (b != NULL)
+        {
+            // The offset keeps growing past the end of a full block, which is harmless
+            uint64_t offset = __atomic_fetch_add(&b->used, size, __ATOMIC_RELAXED);
+            if (offset + size <= b->size)
+            {
+                return b->data + offset;
+            }
+        }
+
+        harena_block* n = create_block(size);
+        n->next = b;
+
+        if (__atomic_compare_exchange_n(&a->blocks, &b, n, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_fetch_add(&a->size, n->size, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            // Another thread installed a block first
+            free(n);
+        }
+    }
+}
+
+/**
+ * @param a An initialized arena
+ */
+void
+harena_destroy(harena* a)
+{
+    assert(a != NULL && "Arena is not initialized");
+
+    harena_block* b = a->blocks;
+    while (b != NULL)
+    {
+        harena_block* next = b->next;
+        free(b);
+        b = next;
+    }
+
+    free(a);
+}
@@ -0,0 +1,71 @@
+#ifndef HAGUE_ARENA_H
+#define HAGUE_ARENA_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdint.h>
+
+typedef struct harena harena;
+
+typedef struct harena_block harena_block;
+
+/** @struct harena
+    @brief A bump pointer allocator
+
+    Memory is carved out of large blocks, so an allocation is a pointer increment and objects allocated one
+    after the other are contiguous in memory. Objects can't be freed one by one, every block is released when
+    the arena is destroyed.
+
+    harena_alloc_concurrent can be called by several threads at the same time, they bump the offset of the
+    most recent block atomically and install a new block with a compare and swap when it is full.
+*/
+struct harena
+{
+    harena_block* blocks; /**< List of blocks, most recent first */
+    char* cursor; /**< First free byte of the current block */
+    char* end; /**< End of the current block */
+    uint64_t size; /**< Total number of bytes allocated to blocks */
+};
+
+/** @struct harena_block
+    @brief A block of memory of an arena
+*/
+struct harena_block
+{
+    harena_block* next; /**< Previously allocated block */
+    uint64_t size; /**< Number of bytes of data */
+    uint64_t used; /**< Number of bytes handed out by harena_alloc_concurrent, size for other blocks */
+    char data[]; /**< Memory handed out by the arena */
+};
+
+/**
+ * @brief Create an empty arena
+ *
+ * @return initialized arena
+ */
+harena*
+harena_create();
+
+/**
+ *
+ * @brief Allocate memory from an arena, aligned for any object of the graph
+ */
+void*
+harena_alloc(harena*, uint64_t);
+
+/**
+ *
+ * @brief Thread-safe version of harena_alloc
+ */
+void*
+harena_alloc_concurrent(harena*, uint64_t);
+
+/**
+ *
+ * @brief Destroy an arena, releasing every object allocated from it
+ */
+void
+harena_destroy(harena*);
+
+#endif
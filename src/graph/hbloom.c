@@ -0,0 +1,33 @@
+#include "hbloom.h"
+
+/**
+ * @param count_counters The number of counters, rounded up to a power of 2 number of blocks
+ * @return An empty filter, every estimate is 0
+ */
+hbloom*
+hbloom_create(uint64_t count_counters)
+{
+    hbloom* f = malloc(sizeof(hbloom));
+    f->count_blocks = 1;
+    while (f->count_blocks * HBLOOM_BLOCK_COUNTERS < count_counters)
+    {
+        f->count_blocks *= 2;
+    }
+
+    f->counters = calloc(f->count_blocks * HBLOOM_BLOCK_COUNTERS, sizeof(uint8_t));
+    assert(f->counters != NULL && "Could not allocate filter");
+
+    return f;
+}
+
+/**
+ * @param f An initialized filter
+ */
+void
+hbloom_destroy(hbloom* f)
+{
+    assert(f != NULL && "Filter is not initialized");
+
+    free(f->counters);
+    free(f);
+}
@@ -0,0 +1,92 @@
+#ifndef HAGUE_BLOOM_H
+#define HAGUE_BLOOM_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * Number of counters of a block, which fills a cache line
+ */
+#define HBLOOM_BLOCK_COUNTERS 64
+
+/**
+ * Number of counters updated for each key, all in the same block
+ */
+#define HBLOOM_PROBES 4
+
+typedef struct hbloom hbloom;
+
+/** @struct hbloom
+    @brief A counting Bloom filter estimating how many times each key has been added
+
+    Each key is hashed to HBLOOM_PROBES counters of one block, so adding a key touches a single cache line.
+    Counters saturate at UINT8_MAX and are updated conservatively: only the smallest ones are incremented. The
+    estimate of a key, i.e. its smallest counter, is never less than the number of times it has been added, and
+    greater only if other keys share all of its counters.
+*/
+struct hbloom
+{
+    uint64_t count_blocks; /**< Number of blocks, always a power of 2 */
+    uint8_t* counters; /**< Counters, HBLOOM_BLOCK_COUNTERS for each block */
+};
+
+/**
+ * @brief Create an empty filter of about a given number of counters
+ *
+ * @return initialized filter
+ */
+hbloom*
+hbloom_create(uint64_t);
+
+/**
+ *
+ * @brief Destroy a filter
+ */
+void
+hbloom_destroy(hbloom*);
+
+/**
+ * @brief Add a key given by its hash to a filter and return its estimated number of occurrences, this one included
+ */
+static inline uint8_t
+hbloom_add(hbloom* f, uint64_t hash)
+{
+    // Remix the hash, whose low bits may already have been used to select a shard or a slot
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+
+    uint8_t* block = &f->counters[(hash & (f->count_blocks - 1)) * HBLOOM_BLOCK_COUNTERS];
+
+    // Counters are taken from the high bits, 6 bits each
+    uint8_t* probes[HBLOOM_PROBES];
+    uint8_t estimate = UINT8_MAX;
+    for (uint64_t i = 0; i < HBLOOM_PROBES; i++)
+    {
+        probes[i] = &block[(hash >> (58 - 6 * i)) & (HBLOOM_BLOCK_COUNTERS - 1)];
+        if (*probes[i] < estimate)
+        {
+            estimate = *probes[i];
+        }
+    }
+
+    if (estimate == UINT8_MAX)
+    {
+        return estimate;
+    }
+
+    for (uint64_t i = 0; i < HBLOOM_PROBES; i++)
+    {
+        if (*probes[i] == estimate)
+        {
+            (*probes[i])++;
+        }
+    }
+
+    return estimate + 1;
+}
+
+#endif
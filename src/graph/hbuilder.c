@@ -0,0 +1,368 @@
+#include "hbuilder.h"
+
+/**
+ * Budget in bytes of the buckets filled by a batch, which bounds the number of characters of a batch
+ */
+#define HBUILDER_BATCH_BUCKET_BYTES ((uint64_t) 64 << 20)
+
+/**
+ *  Append an entry made of a packed key and a base to bucket b, the multiplicity of the edge is stored above the base
+ */
+static inline void
+bucket_push(hbuilder_bucket* b, const uint64_t* key, uint64_t key_words, uint8_t base, uint32_t multiplicity)
+{
+    if (b->length + key_words + 1 > b->capacity)
+    {
+        b->capacity = b->capacity == 0 ? 1024 : b->capacity * 2;
+        b->entries = realloc(b->entries, b->capacity * sizeof(uint64_t));
+        assert(b->entries != NULL && "Could not allocate bucket");
+    }
+
+    memcpy(&b->entries[b->length], key, key_words * sizeof(uint64_t));
+    b->entries[b->length + key_words] = base | (uint64_t) multiplicity << 3;
+    b->length += key_words + 1;
+}
+
+/**
+ *  Send each side of the edge of the last k-mer read by it to the bucket of worker w for the shard of its vertex.
+ *  Filtered k-mers only send their outgoing side, the incoming one is sent by insert_starts if the k-mer is solid
+ */
+static inline void
+push_kmer(hbuilder_worker* w, hkmer_iter* it)
+{
+    hgraph* g = w->builder->g;
+
+    uint64_t* start;
+    uint64_t* end;
+    uint8_t last;
+    uint8_t first;
+    hgraph_orient_edge(g, it->prefix, it->suffix, w->keys, &start, &last, &end, &first);
+
+    bucket_push(&w->starts[hgraph_shard_index(g, start)], start, it->words, last, 1);
+
+    if (g->min_count == 1)
+    {
+        bucket_push(&w->ends[hgraph_shard_index(g, end)], end, it->words, first, 1);
+    }
+}
+
+/**
+ *  Extract the k-mers ending in the slice of the batch of worker w, sending each side of their edges to the
+ *  bucket of the shard of its vertex
+ */
+static void
+extract_kmers(hbuilder_worker* w)
+{
+    hbuilder* b = w->builder;
+    hgraph* g = b->g;
+    uint64_t key_length = g->k - 1;
+
+    const char* batch = b->batch;
+    uint64_t length = b->batch_length;
+
+    hkmer_iter it;
+    hkmer_iter_init(&it, g->k);
+
+    if (b->text == NULL)
+    {
+        uint64_t slice = (length + b->count_workers - 1) / b->count_workers;
+        uint64_t begin = w->id * slice < length ? w->id * slice : length;
+        uint64_t end = begin + slice < length ? begin + slice : length;
+
+        // Start k - 1 characters early, so that the first k-mer returned is the one ending at begin
+        for (uint64_t i = begin > key_length ? begin - key_length : 0; i < end; i++)
+        {
+            if (hkmer_iter_next(&it, batch[i]))
+            {
+                push_kmer(w, &it);
+            }
+        }
+    }
+    else
+    {
+        // Slices of FASTA text are cut anywhere, even inside a line, and parsing starts k - 1 bases before the
+        // slice in the same record, since they may be spread over several lines
+        mapped_cut cut;
+        const char* slice_end = mapped_slice(&cut, b->text, &b->start, length, w->id, b->count_workers, key_length);
+        hkmer_iter_resume_text(&it, cut.line_start, cut.parse_header);
+
+        for (const char* c = cut.parse; c < slice_end; c++)
+        {
+            if (hkmer_iter_next_text(&it, *c) && c >= cut.p)
+            {
+                push_kmer(w, &it);
+            }
+        }
+    }
+
+    hkmer_iter_destroy(&it);
+}
+
+/**
+ *  Insert into the shard of worker w every outgoing side sent to it by any worker, then empty those buckets. If
+ *  k-mers are filtered, only solid ones are inserted and their incoming sides are sent by worker w
+ */
+static void
+insert_starts(hbuilder_worker* w)
+{
+    hbuilder* b = w->builder;
+    hgraph* g = b->g;
+    hgraph_shard* shard = &g->shards[w->id];
+    uint64_t key_words = g->key_words;
+
+    // Buckets are visited in worker order, so the graph doesn't depend on thread scheduling
+    for (uint64_t i = 0; i < b->count_workers; i++)
+    {
+        hbuilder_bucket* starts = &b->workers[i].starts[w->id];
+        for (uint64_t j = 0; j < starts->length; j += key_words + 1)
+        {
+            uint64_t* start = &starts->entries[j];
+            uint8_t last = start[key_words] & (HGRAPH_REVERSE | 3);
+
+            uint32_t multiplicity = hgraph_shard_filter_kmer(g, shard, start, last);
+            if (multiplicity == 0)
+            {
+                continue;
+            }
+            hgraph_shard_add_edge_start(shard, start, last, multiplicity);
+
+            if (g->min_count > 1)
+            {
+                uint64_t* end;
+                uint8_t first;
+                hgraph_edge_end(g, start, last, w->keys, &end, &first);
+                bucket_push(&w->ends[hgraph_shard_index(g, end)], end, key_words, first, multiplicity);
+            }
+        }
+        starts->length = 0;
+    }
+}
+
+/**
+ *  Insert into the shard of worker w every incoming side sent to it by any worker, then empty those buckets
+ */
+static void
+insert_ends(hbuilder_worker* w)
+{
+    hbuilder* b = w->builder;
+    hgraph_shard* shard = &b->g->shards[w->id];
+    uint64_t key_words = b->g->key_words;
+
+    for (uint64_t i = 0; i < b->count_workers; i++)
+    {
+        hbuilder_bucket* ends = &b->workers[i].ends[w->id];
+        for (uint64_t j = 0; j < ends->length; j += key_words + 1)
+        {
+            uint64_t entry = ends->entries[j + key_words];
+            hgraph_shard_add_edge_end(shard, &ends->entries[j], entry & (HGRAPH_REVERSE | 3), entry >> 3);
+        }
+        ends->length = 0;
+    }
+}
+
+/**
+ *  Add the k-mers of the current batch with worker w, in phases separated by barriers shared with the other workers
+ */
+static void
+run_batch(hbuilder_worker* w)
+{
+    hbuilder* b = w->builder;
+
+    extract_kmers(w);
+    pthread_barrier_wait(&b->insert);
+    insert_starts(w);
+
+    // Filtered k-mers send their incoming sides while outgoing ones are inserted
+    if (b->g->min_count > 1)
+    {
+        pthread_barrier_wait(&b->filter);
+    }
+    insert_ends(w);
+}
+
+/**
+ *  Body of the threads of workers other than 0, which follow the batches until the builder is done
+ */
+static void*
+run_worker(void* arg)
+{
+    hbuilder_worker* w = arg;
+    hbuilder* b = w->builder;
+
+    for (;;)
+    {
+        pthread_barrier_wait(&b->extract);
+        if (b->batch == NULL)
+        {
+            break;
+        }
+
+        run_batch(w);
+    }
+
+    hgraph_link_shard(b->g, w->id);
+
+    return NULL;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return The number of characters of a batch whose k-mers fit in the bucket budget
+ */
+uint64_t
+hbuilder_batch_capacity(hgraph* g)
+{
+    // Each k-mer sends two entries of key_words + 1 words
+    return HBUILDER_BATCH_BUCKET_BYTES / (2 * (g->key_words + 1) * sizeof(uint64_t));
+}
+
+/**
+ *  Initialize builder b for graph g and start the threads of its workers other than 0
+ */
+static void
+start_workers(hbuilder* b, hgraph* g, uint64_t threads)
+{
+    assert(g != NULL && "Graph is not initialized");
+    assert(g->count_shards == threads && "Graph must have one shard for each thread");
+
+    b->g = g;
+    b->count_workers = threads;
+    b->workers = malloc(threads * sizeof(hbuilder_worker));
+    b->batch = NULL;
+    b->batch_length = 0;
+    b->text = NULL;
+    assert(b->workers != NULL && "Could not allocate builder");
+
+    pthread_barrier_init(&b->extract, NULL, threads);
+    pthread_barrier_init(&b->insert, NULL, threads);
+    pthread_barrier_init(&b->filter, NULL, threads);
+
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        hbuilder_worker* w = &b->workers[i];
+        w->builder = b;
+        w->id = i;
+        w->starts = calloc(threads, sizeof(hbuilder_bucket));
+        w->ends = calloc(threads, sizeof(hbuilder_bucket));
+        w->keys = malloc(2 * g->key_words * sizeof(uint64_t));
+        assert(w->starts != NULL && w->ends != NULL && "Could not allocate buckets");
+
+        if (i > 0)
+        {
+            int error = pthread_create(&w->thread, NULL, run_worker, w);
+            assert(error == 0 && "Could not create worker thread");
+        }
+    }
+}
+
+/**
+ *  Process the current batch of builder b with every worker, the calling thread being worker 0
+ */
+static void
+process_batch(hbuilder* b)
+{
+    pthread_barrier_wait(&b->extract);
+    run_batch(&b->workers[0]);
+}
+
+/**
+ *  Stop the workers of builder b, link the successors of every shard and free the builder
+ */
+static void
+finish_workers(hbuilder* b)
+{
+    b->batch = NULL;
+    pthread_barrier_wait(&b->extract);
+    hgraph_link_shard(b->g, 0);
+
+    for (uint64_t i = 0; i < b->count_workers; i++)
+    {
+        hbuilder_worker* w = &b->workers[i];
+        if (i > 0)
+        {
+            pthread_join(w->thread, NULL);
+        }
+
+        for (uint64_t j = 0; j < b->count_workers; j++)
+        {
+            free(w->starts[j].entries);
+            free(w->ends[j].entries);
+        }
+        free(w->starts);
+        free(w->ends);
+        free(w->keys);
+    }
+
+    pthread_barrier_destroy(&b->extract);
+    pthread_barrier_destroy(&b->insert);
+    pthread_barrier_destroy(&b->filter);
+    free(b->workers);
+}
+
+/**
+ * @param g An empty hague graph with one shard for each thread
+ * @param p A pipeline whose batches are at most hbuilder_batch_capacity(g) characters long
+ * @param threads The number of threads, the calling thread included
+ *
+ * Edges are added to g as hgraph_add_sequence would do for each batch, and successors are linked
+ */
+void
+hbuilder_add_batches(hgraph* g, pipeline* p, uint64_t threads)
+{
+    hbuilder b;
+    start_workers(&b, g, threads);
+
+    bool validfile = false;
+    pipeline_batch* batch;
+    while ((batch = pipeline_acquire(p)) != NULL)
+    {
+        validfile = true;
+
+        b.batch = batch->data;
+        b.batch_length = batch->length;
+        b.text = p->text ? batch->data : NULL;
+        if (p->text)
+        {
+            mapped_cut_text(&b.start, b.batch, b.batch + b.batch_length, b.batch, g->k - 1, NULL);
+        }
+        process_batch(&b);
+        pipeline_release(p, batch);
+    }
+    assert(validfile && "Invalid file content");
+
+    finish_workers(&b);
+}
+
+/**
+ * @param g An empty hague graph with one shard for each thread
+ * @param text FASTA text, e.g. a mapped file
+ * @param length The length of text
+ * @param threads The number of threads, the calling thread included
+ *
+ * Edges are added to g as hgraph_add_fasta would do, and successors are linked. The text is processed in
+ * batches of hbuilder_batch_capacity(g) characters, cut anywhere, so that a record on a single line is split
+ * between the batches and the threads as a wrapped one is
+ */
+void
+hbuilder_add_text(hgraph* g, const char* text, uint64_t length, uint64_t threads)
+{
+    hbuilder b;
+    start_workers(&b, g, threads);
+    b.text = text;
+
+    const char* end = text + length;
+    uint64_t capacity = hbuilder_batch_capacity(g);
+    mapped_cut_text(&b.start, text, end, text, g->k - 1, NULL);
+
+    for (const char* batch = text; batch < end; batch += b.batch_length)
+    {
+        // The header state of each batch is found from the previous one, without looking back further
+        mapped_cut prev = b.start;
+        mapped_cut_text(&b.start, text, end, batch, g->k - 1, &prev);
+        b.batch = batch;
+        b.batch_length = capacity < (uint64_t) (end - batch) ? capacity : (uint64_t) (end - batch);
+        process_batch(&b);
+    }
+
+    finish_workers(&b);
+}
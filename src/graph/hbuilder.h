@@ -0,0 +1,97 @@
+#ifndef HAGUE_BUILDER_H
+#define HAGUE_BUILDER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "utils/initializer.h"
+#include "klib/kseq.h"
+#include "graph/hkmer.h"
+#include "graph/hgraph.h"
+#include "io/pipeline.h"
+#include "io/mapped.h"
+
+typedef struct hbuilder hbuilder;
+
+typedef struct hbuilder_bucket hbuilder_bucket;
+
+typedef struct hbuilder_worker hbuilder_worker;
+
+/** @struct hbuilder_bucket
+    @brief A growable array of edge sides sent by a worker to a shard
+
+    Each entry is a packed vertex key followed by one word holding a base: the last base of the edge for the
+    outgoing side of its starting vertex, the first base of the edge for the incoming side of its ending vertex.
+    The base may be flagged with HGRAPH_REVERSE and the multiplicity of the edge is stored above these 3 bits.
+*/
+struct hbuilder_bucket
+{
+    uint64_t* entries; /**< Entries, key_words + 1 words each */
+    uint64_t length; /**< Number of used words */
+    uint64_t capacity; /**< Number of allocated words */
+};
+
+/** @struct hbuilder_worker
+    @brief A thread adding k-mers to a sharded hague graph
+*/
+struct hbuilder_worker
+{
+    hbuilder* builder; /**< Builder the worker belongs to */
+    uint64_t id; /**< Index of the worker, which is also the index of the shard it inserts into */
+    pthread_t thread; /**< Thread running the worker, unused for worker 0 which runs on the calling thread */
+    hbuilder_bucket* starts; /**< Outgoing sides extracted by the worker, one bucket for each shard */
+    hbuilder_bucket* ends; /**< Incoming sides extracted by the worker, one bucket for each shard */
+    uint64_t* keys; /**< Scratch buffer of 2 keys, e.g. for reverse complements */
+};
+
+/** @struct hbuilder
+    @brief Parallel construction of a De Bruijn graph with one shard for each thread
+
+    Batches are either sequences read by a pipeline or chunks of a mapped FASTA file, parsed in place. Each batch
+    is processed in two phases separated by barriers: each worker extracts the k-mers ending in its slice of the
+    batch and sends the two sides of each edge to the buckets of the shards of its vertices, then each worker
+    inserts the entries of every bucket sent to its own shard. Shards are never touched by two threads at once,
+    so no lock is needed. Successors are linked once every batch has been inserted.
+
+    When k-mers are filtered, the filter of a k-mer is in the shard of its starting vertex, so the incoming sides
+    are only sent by the insertion of the outgoing sides of solid k-mers, in a third phase.
+*/
+struct hbuilder
+{
+    hgraph* g; /**< Graph being built, with one shard for each worker */
+    uint64_t count_workers; /**< Number of workers */
+    hbuilder_worker* workers; /**< Workers */
+    const char* batch; /**< Characters of the current batch, NULL when every batch has been processed */
+    uint64_t batch_length; /**< Number of characters of the current batch */
+    const char* text; /**< Beginning of the FASTA text the batch is a chunk of, NULL if it holds bare sequences */
+    mapped_cut start; /**< Cut of the text at the beginning of the batch, if it is a chunk of FASTA text */
+    pthread_barrier_t extract; /**< Workers wait here for a new batch */
+    pthread_barrier_t insert; /**< Workers wait here for every k-mer of the batch to be extracted */
+    pthread_barrier_t filter; /**< Workers wait here for every solid k-mer to send its incoming side, if filtered */
+};
+
+/**
+ *
+ * @brief Return the maximum number of characters of a batch processed by hbuilder_add_batches for an hague graph
+ */
+uint64_t
+hbuilder_batch_capacity(hgraph*);
+
+/**
+ *
+ * @brief Add the k-mers of every batch of a pipeline to an hague graph with one shard for each thread
+ */
+void
+hbuilder_add_batches(hgraph*, pipeline*, uint64_t);
+
+/**
+ *
+ * @brief Add the k-mers of a FASTA text to an hague graph with one shard for each thread
+ */
+void
+hbuilder_add_text(hgraph*, const char*, uint64_t, uint64_t);
+
+#endif
@@ -0,0 +1,211 @@
+#include "hexport.h"
+
+/**
+ *  Number the vertices of g in the order of the shards then of their slots, setting ids[s][i] to the ID of the
+ *  vertex of slot i of shard s. Set count_nodes to the number of vertices and return the number of distinct edges
+ */
+static uint64_t
+number_vertices(hgraph* g, uint64_t** ids, uint64_t* count_nodes)
+{
+    uint64_t count_edges = 0;
+    uint64_t id = 0;
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+        ids[s] = malloc(vertices->capacity * sizeof(uint64_t));
+        assert(ids[s] != NULL && "Could not allocate vertex IDs");
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v != NULL)
+            {
+                ids[s][i] = id++;
+                count_edges += __builtin_popcount(v->successors);
+            }
+        }
+    }
+
+    *count_nodes = id;
+
+    return count_edges;
+}
+
+/**
+ *  Write to o the header of a binary table of the given kind
+ */
+static void
+write_header(hgraph* g, output* o, uint32_t kind, uint64_t count_nodes, uint64_t count_edges)
+{
+    hexport_header h;
+    memset(&h, 0, sizeof(hexport_header));
+    memcpy(h.magic, HEXPORT_MAGIC, sizeof(HEXPORT_MAGIC));
+    h.version = HEXPORT_VERSION;
+    h.kind = kind;
+    h.k = g->k;
+    h.count_nodes = count_nodes;
+    h.count_edges = count_edges;
+
+    output_write(o, (const char*) &h, sizeof(hexport_header));
+}
+
+/**
+ *  Write the vertices of g to o in the order of their IDs, as "Id, Label" lines or as packed keys
+ */
+static void
+write_nodes(hgraph* g, output* o, bool binary, uint64_t count_nodes, uint64_t count_edges)
+{
+    uint64_t key_length = g->k - 1;
+    char* label = malloc(key_length + 2);
+    uint64_t id = 0;
+
+    if (binary)
+    {
+        write_header(g, o, HEXPORT_NODES, count_nodes, count_edges);
+    }
+    else
+    {
+        output_write(o, "Id, Label\n", 10);
+    }
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            if (vertices->values[i] == NULL)
+            {
+                continue;
+            }
+
+            const uint64_t* key = htable_key_at(vertices, i);
+            if (binary)
+            {
+                output_write(o, (const char*) key, g->key_words * sizeof(uint64_t));
+                continue;
+            }
+
+            hkmer_decode(key, key_length, label);
+            label[key_length] = '\n';
+            output_uint(o, id++);
+            output_write(o, ", ", 2);
+            output_write(o, label, key_length + 1);
+        }
+    }
+
+    free(label);
+}
+
+/**
+ *  Write the distinct edges of g to o, as "Source, Target, Base, Weight" lines or as hexport_edge records. The
+ *  shard and the slot of a target are found from its key, the source key followed by the base of the edge
+ */
+static void
+write_edges(hgraph* g, output* o, bool binary, uint64_t* const* ids, uint64_t count_nodes, uint64_t count_edges)
+{
+    uint64_t key_length = g->k - 1;
+    uint64_t* target = malloc(g->key_words * sizeof(uint64_t));
+
+    if (binary)
+    {
+        write_header(g, o, HEXPORT_EDGES, count_nodes, count_edges);
+    }
+    else
+    {
+        output_write(o, "Source, Target, Base, Weight\n", 29);
+    }
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v == NULL)
+            {
+                continue;
+            }
+
+            hexport_edge e;
+            memset(&e, 0, sizeof(hexport_edge));
+            e.source = ids[s][i];
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                if (!hgraph_vertex_has_successor(v, base))
+                {
+                    continue;
+                }
+
+                memcpy(target, htable_key_at(vertices, i), g->key_words * sizeof(uint64_t));
+                hkmer_push_back(target, key_length, base);
+                uint64_t t = hgraph_shard_index(g, target);
+                e.target = ids[t][htable_slot(g->shards[t].vertices, target)];
+                e.count = v->out_multiplicity[base];
+                e.base = base;
+
+                if (binary)
+                {
+                    output_write(o, (const char*) &e, sizeof(hexport_edge));
+                    continue;
+                }
+
+                output_uint(o, e.source);
+                output_write(o, ", ", 2);
+                output_uint(o, e.target);
+                output_write(o, ", ", 2);
+                output_char(o, hkmer_decode_base(base));
+                output_write(o, ", ", 2);
+                output_uint(o, e.count);
+                output_char(o, '\n');
+            }
+        }
+    }
+
+    free(target);
+}
+
+/**
+ * @param g An initialized hague graph of the forward strand
+ * @param filename Prefix of the names of the output files, followed by ".nodes" and ".edges"
+ * @param binary True to write binary tables, false to write Gephi "Nodes table" and "Edges table" notation
+ *
+ * Each vertex is written once with its ID, and each distinct edge once with the IDs of its vertices, the last
+ * base of its label and the number of times it has been added, instead of repeating the keys on every edge.
+ * IDs follow the order of the shards then of their slots, and are stored in an array of each shard indexed by
+ * slot, so the vertices are left unchanged
+ */
+void
+hexport_tables(hgraph* g, const char* filename, bool binary)
+{
+    assert(g != NULL && "Graph is not initialized");
+    assert(!g->canonical && "Integer ID tables need a graph of the forward strand");
+
+    uint64_t** ids = malloc(g->count_shards * sizeof(uint64_t*));
+    uint64_t name_length = strlen(filename) + 7;
+    char* name = malloc(name_length);
+    assert(ids != NULL && name != NULL && "Could not allocate tables");
+
+    uint64_t count_nodes;
+    uint64_t count_edges = number_vertices(g, ids, &count_nodes);
+
+    snprintf(name, name_length, "%s.nodes", filename);
+    output* o = output_open(name);
+    write_nodes(g, o, binary, count_nodes, count_edges);
+    output_close(o);
+
+    snprintf(name, name_length, "%s.edges", filename);
+    o = output_open(name);
+    write_edges(g, o, binary, ids, count_nodes, count_edges);
+    output_close(o);
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        free(ids[s]);
+    }
+    free(ids);
+    free(name);
+}
@@ -0,0 +1,76 @@
+#ifndef HAGUE_EXPORT_H
+#define HAGUE_EXPORT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/hgraph.h"
+#include "io/output.h"
+
+/**
+ * First bytes of a binary table, the terminator included
+ */
+#define HEXPORT_MAGIC "HAGUEID"
+
+/**
+ * Version of the layout of binary tables, incremented on every incompatible change
+ */
+#define HEXPORT_VERSION 1
+
+/**
+ * Kind of a binary table of nodes
+ */
+#define HEXPORT_NODES 0
+
+/**
+ * Kind of a binary table of edges
+ */
+#define HEXPORT_EDGES 1
+
+typedef struct hexport_header hexport_header;
+
+typedef struct hexport_edge hexport_edge;
+
+/** @struct hexport_header
+    @brief Beginning of a binary table
+
+    A binary table of nodes is made of this header followed by the packed key of each node, key_words words
+    each, in the order of their IDs. A binary table of edges is made of this header followed by an hexport_edge
+    for each distinct edge. Both are in the byte order of the machine which wrote them.
+*/
+struct hexport_header
+{
+    char magic[8]; /**< HEXPORT_MAGIC */
+    uint32_t version; /**< HEXPORT_VERSION */
+    uint32_t kind; /**< HEXPORT_NODES or HEXPORT_EDGES */
+    uint64_t k; /**< Length of the k-mers, node keys are (k-1)-mers */
+    uint64_t count_nodes; /**< Number of nodes */
+    uint64_t count_edges; /**< Number of distinct edges */
+};
+
+/** @struct hexport_edge
+    @brief An edge of a binary table, from a node to the node reached through its last base
+*/
+struct hexport_edge
+{
+    uint64_t source; /**< ID of the source node */
+    uint64_t target; /**< ID of the target node */
+    uint32_t count; /**< Number of times the edge has been added */
+    uint8_t base; /**< Last base of the label of the edge, 2 bits as packed by hkmer */
+    uint8_t padding[3]; /**< Unused, set to 0 */
+};
+
+/**
+ *
+ * @brief Write the vertices of an hague graph of the forward strand with dense integer IDs to a nodes file, and
+ * its edges between IDs to an edges file, as text or binary tables
+ */
+void
+hexport_tables(hgraph*, const char*, bool);
+
+#endif
@@ -1,432 +1,1944 @@
-#include "hgraph.h"
-
-/**
- *  Detect if the graph g has been initialized
- */
-static inline void
-assert_graph_init(hgraph* g)
-{
-    assert(g != NULL && "Graph is not initialized");
-}
-
-/**
- *  Detect if eulerian properties of graph g have been computed
- */
-static inline void
-assert_eulerian_properties_computed(hgraph* g)
-{
-    assert_graph_init(g);
-
-    uint64_t count_vertices_by_type = (g->count_balanced_vertices + g->count_semi_balanced_vertices
-                                                                  + g->count_generic_vertices);
-    assert(count_vertices_by_type == g->count_vertices &&
-                   "Eulerian properties not computed, try calling hgraph_compute__eulerian_path_properties(hgraph)");
-
-}
-
-hgraph*
-hgraph_create()
-{
-    hgraph* g = malloc(sizeof(hgraph));
-    g->count_vertices = 0;
-    g->count_edges = 0;
-    g->count_semi_balanced_vertices = 0;
-    g->count_balanced_vertices = 0;
-    g->count_generic_vertices = 0;
-    g->walk_start_vertex = NULL;
-    g->walk_end_vertex = NULL;
-    g->vertices = NULL;
-
-    return g;
-}
-
-/**
- *  @param g An initialized hague graph
- *  @return Number of vertices in g
- */
-uint64_t
-hgraph_vertex_count(hgraph* g)
-{
-    assert_graph_init(g);
-
-    return g->count_vertices;
-}
-
-/**
- * @param g An initialized hague graph
- * @return Number of edges in g
- */
-uint64_t
-hgraph_edge_count(hgraph* g)
-{
-    assert_graph_init(g);
-
-    return g->count_edges;
-}
-
-/**
- *  @param g An initialized hague graph
- *  @param key The label of the vertex
- *  @return An hague vertex if g has a vertex with label "key", NULL otherwise
- */
-hgraph_vertex*
-hgraph_get_vertex(hgraph* g, char* key)
-{
-    assert_graph_init(g);
-
-    hgraph_vertex* v = NULL;
-
-    HASH_FIND_STR(g->vertices, key, v);
-
-    return v;
-}
-
-/**
- * @param g An initialized hague graph
- * @param key The label of the vertex
- * @return An hague vertex if g doesn't have a vertex with label "key", NULL otherwise
- */
-hgraph_vertex*
-hgraph_add_vertex(hgraph* g, char* key)
-{
-    assert_graph_init(g);
-
-    hgraph_vertex* v = hgraph_get_vertex(g, key);
-    if (v == NULL)
-    {
-        v = malloc(sizeof(hgraph_vertex));
-        v->indegree = 0;
-        v->outdegree = 0;
-        v->next_neighbour = 0;
-        v->key = malloc(strlen(key) * sizeof(char) + 1);
-        strcpy(v->key, key);
-        v->neighbours = NULL;
-
-        g->count_vertices++;
-        HASH_ADD_STR(g->vertices, key, v);
-    }    
-
-    return v;
-}
-
-/**
- * @param g An initialized hague graph
- * @param start Label of starting node
- * @param end Label of ending node
- * @return The created hague edge
- *
- * The label of the edge is obtained concatenating the label of the starting node and the last
- * character of the label of the ending node
- */
-hgraph_edge*
-hgraph_add_edge(hgraph* g, char* start, char* end)
-{
-    assert_graph_init(g);
-
-    hgraph_vertex* v_s = hgraph_add_vertex(g, start);
-    v_s->outdegree++;
-    
-    hgraph_vertex* v_e = hgraph_add_vertex(g, end);
-    v_e->indegree++;
-
-    v_s->neighbours = realloc(v_s->neighbours, v_s->outdegree * sizeof(hgraph_edge*));
-
-    hgraph_edge* e = malloc(sizeof(hgraph_edge));
-    uint64_t llength = strlen(start) + 1;
-    e->label = malloc(llength * sizeof(char) + 1);
-    e->next = malloc(strlen(end) * sizeof(char) + 1);
-    strcpy(e->next, end);
-    strncpy(e->label, start, strlen(start)); // Copy first (k-1)-mer chars
-    strncpy(&(e->label[llength - 1]), &(end[strlen(end) - 1]), 1); // copy last char
-    e->label[llength] = '\0';
-
-    v_s->neighbours[v_s->outdegree - 1] = e;
-
-    g->count_edges++;
-
-    return e;
-}
-
-/**
- * @param g An initialized hague graph
- *
- * Remove the graph from memory
- */
-void
-hgraph_destroy(hgraph* g)
-{
-    assert_graph_init(g);
-
-    hgraph_vertex* v = NULL;
-    hgraph_vertex* tmp = NULL;
-
-    HASH_ITER(hh, g->vertices, v, tmp)
-    {
-
-        HASH_DEL(g->vertices, v);
-
-        for (uint64_t j = 0; j < v->outdegree; j++)
-        {
-            hgraph_edge* e = v->neighbours[j];
-            free(e->label);
-            free(e->next);
-            free(e);
-        }
-
-        free(v->key);
-        free(v->neighbours);
-        free(v);
-    }
-
-    free(g->vertices);
-    free(g);
-}
-
-/**
- * @param g An initialized hague graph
- * @return The eulerian walk starting vertex if exists, NULL otherwise
- */
-hgraph_vertex*
-hgraph_eulerian_walk_start(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-
-    return g->walk_start_vertex;
-}
-
-/**
- * @param g An initialized hague graph
- * @return The eulerian walk ending vertex if exists, NULL otherwise
- */
-hgraph_vertex*
-hgraph_eulerian_walk_end(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-
-    return g->walk_end_vertex;
-}
-
-/**
- * @param g An initialized hague graph
- *
- * Set the starting and ending node of the eulerian walk(if exists) and detect if the graph is eulerian, semi-eularian
- * or a generic graph
- */
-void
-hgraph_compute_eulerian_path_properties(hgraph* g)
-{
-    assert_graph_init(g);
-
-    hgraph_vertex* v = NULL;
-    hgraph_vertex* first = NULL;
-    hgraph_vertex* tmp = NULL;
-
-    HASH_ITER(hh, g->vertices, v, tmp) {
-        
-        if (first == NULL)
-        {
-            first = v;
-        }
-
-        if (v->indegree == v->outdegree)
-        {
-            g->count_balanced_vertices++;
-        }
-        else if (abs(v->indegree - v->outdegree) == 1)
-        {
-            g->count_semi_balanced_vertices++;
-
-            if (v->indegree == v->outdegree + 1)
-            {
-                g->walk_end_vertex = v;
-            }
-
-            if (v->outdegree == v->indegree + 1)
-            {
-                g->walk_start_vertex = v;
-            }
-        }
-        else
-        {
-            g->count_generic_vertices++;
-        }
-    }
-
-    if (hgraph_has_eulerian_cycle(g))
-    {
-        g->walk_start_vertex = first;
-        g->walk_end_vertex = g->walk_start_vertex;
-    }
-}
-
-/**
- * @param g An initialized hague graph
- * @return True, if g has eulerian path, false otherwise
- */
-bool
-hgraph_has_eulerian_path(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-    bool is_semi_eulerian = (g->count_semi_balanced_vertices == 2) && (g->count_generic_vertices == 0);
-
-    return is_semi_eulerian;
-}
-
-/**
- * @param g An initialized hague graph
- * @return True, if g has eulerian cycle, false otherwise
- */
-bool
-hgraph_has_eulerian_cycle(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-    bool is_eulerian = (g->count_generic_vertices == 0) && (g->count_semi_balanced_vertices == 0);
-    return is_eulerian;
-}
-
-/**
- * @param g An initialized hague graph
- * @return True, if eulerian properties have already been computed on g, false otherwise
- */
-bool
-hgraph_has_eulerian_properties(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-
-    return hgraph_has_eulerian_path(g) || hgraph_has_eulerian_cycle(g);
-}
-
-/**
- * @param g An initialized hague graph
- * @return A string containing the concatenation of edge labels, from eulerian walk starting node to ending node
- *
- * Eulerian properties must have been already computed on g
- */
-char*
-hgraph_compute_eulerian_walk(hgraph* g)
-{
-    assert_eulerian_properties_computed(g);
-
-    hgraph_vertex* start = hgraph_eulerian_walk_start(g);
-    hgraph_vertex* end = hgraph_eulerian_walk_end(g);
-    hgraph_vertex* next = start;
-
-    uint64_t kmer_length = strlen(start->key) + 1;
-    uint64_t result_length = g->count_edges + kmer_length - 1;
-
-    char* result = malloc(result_length * sizeof(char) + 1);
-
-    for (uint64_t i = 0; i < result_length - kmer_length + 1; i++)
-    {   
-        uint64_t j = next->next_neighbour;
-        if (j < next->outdegree)
-        {
-            hgraph_edge* edge = next->neighbours[j];
-            next->next_neighbour++;
-
-            // haven't reached the last edge yet
-            if (i < result_length - kmer_length)
-            {
-                next = hgraph_get_vertex(g, edge->next);
-
-                result[i] = edge->label[0];
-            }
-            else
-            {
-                strncpy(&result[i], edge->label, strlen(edge->label));
-            }
-        }
-    }
-
-    result[result_length] = '\0';
-
-    return result;
-}
-
-/**
- * @param seq A FASTA sequence parsed using kseq library
- * @param k The length of the k-mer
- * @return An empty hague graph if seq is not valid or an hague graph representing a De Bruijn graph otherwise
- */
-hgraph*
-hgraph_create_de_bruijn_graph(kseq_t* seq, uint64_t k)
-{
-    hgraph* g = hgraph_create();
-    bool validfile = false;
-    while ((kseq_read(seq)) >= 0)
-    {
-        validfile = true;
-        char* s = seq->seq.s;
-
-        assert(strlen(s) >= k && "Sequence length must be equal to or greater than k-mer length");
-
-        for (uint64_t i = 0; i < strlen(s) - k + 1; i++)
-        {
-            char* kmer = malloc(k * sizeof(char) + 1);
-            strncpy(kmer, &s[i], k);
-            kmer[k] = '\0';
-
-            char* lk = malloc((k - 1) * sizeof(char) + 1);
-            char* rk = malloc((k - 1) * sizeof(char) + 1);
-            strncpy(lk, kmer, (k - 1));
-            lk[k - 1] = '\0';
-            strncpy(rk, &kmer[1], (k - 1));
-            rk[k - 1] = '\0';
-
-            hgraph_add_edge(g, lk, rk);
-
-            free(kmer);
-            free(lk);
-            free(rk);
-        }
-    }
-    assert(validfile && "Invalid file content");
-
-    return g;
-}
-
-/**
- * @param g An initialized hague graph
- * @param filename Name of the outpur file
- */
-void
-hgraph_export_to_file(hgraph* g, char* filename)
-{
-    assert_graph_init(g);
-    hgraph_vertex* v = NULL;
-    hgraph_vertex* tmp = NULL;
-    FILE *f = fopen(filename, "w");
-    fprintf(f, "Source, Target, Label\n");
-
-    HASH_ITER(hh, g->vertices, v, tmp)
-    {
-        for(uint64_t i = 0; i < v->outdegree; i++)
-        {
-            hgraph_edge* edge = v->neighbours[i];
-            fprintf(f, "%s, %s, %s\n", v->key, edge->next, edge->label);
-        }
-    }
-
-    fclose(f);
-}
-
-/**
- * @param g An initialized hague graph
- */
-void
-hgraph_print_graph(hgraph* g)
-{
-    assert_graph_init(g);
-    hgraph_vertex* v = NULL;
-    hgraph_vertex* tmp = NULL;
-    printf("Source, Target, Label\n");
-
-    HASH_ITER(hh, g->vertices, v, tmp)
-    {
-        for(uint64_t i = 0; i < v->outdegree; i++)
-        {
-            hgraph_edge* edge = v->neighbours[i];
-            printf("%s, %s, %s\n", v->key, edge->next, edge->label);
-        }
-    }
-}
\ No newline at end of file
+#include "hgraph.h"
+#include "hbuilder.h"
+#include "hsort.h"
+
+/**
+ * Maximum number of characters of a batch read by the pipeline when the graph is built by one thread
+ */
+#define HGRAPH_BATCH_LENGTH ((uint64_t) 1 << 20)
+
+/**
+ * Number of buffers of the ring of the reader pipeline
+ */
+#define HGRAPH_PIPELINE_BUFFERS 4
+
+/**
+ * Number of counters of the k-mer filter when the length of the input is unknown
+ */
+#define HGRAPH_FILTER_COUNTERS ((uint64_t) 1 << 26)
+
+/**
+ *  Detect if the graph g has been initialized
+ */
+static inline void
+assert_graph_init(hgraph* g)
+{
+    assert(g != NULL && "Graph is not initialized");
+}
+
+/**
+ *  Detect if the vertices of every shard of graph g are classified by the balance of their degrees
+ */
+static inline void
+assert_eulerian_properties_computed(hgraph* g)
+{
+    assert_graph_init(g);
+
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        assert(!g->shards[i].stale &&
+               "Eulerian properties not computed, try calling hgraph_compute_eulerian_path_properties(hgraph)");
+    }
+}
+
+/**
+ * @param k The length of the k-mers, must be greater than 1
+ * @return An empty hague graph whose vertices are (k-1)-mers
+ */
+hgraph*
+hgraph_create(uint64_t k)
+{
+    return hgraph_create_sharded(k, 1);
+}
+
+/**
+ * @param k The length of the k-mers, must be greater than 1
+ * @param count_shards The number of shards, must be greater than 0
+ * @return An empty hague graph whose vertices are (k-1)-mers
+ */
+hgraph*
+hgraph_create_sharded(uint64_t k, uint64_t count_shards)
+{
+    assert(k > 1 && "k-mer length must be greater than 1");
+    assert(count_shards > 0 && "Number of shards must be greater than 0");
+
+    hgraph* g = malloc(sizeof(hgraph));
+    g->k = k;
+    g->key_words = hkmer_words(k - 1);
+    g->walk_start_vertex = NULL;
+    g->walk_end_vertex = NULL;
+    g->walk_start_key = calloc(g->key_words, sizeof(uint64_t));
+    g->walk_end_key = calloc(g->key_words, sizeof(uint64_t));
+    g->min_count = 1;
+    g->canonical = false;
+    g->reverse_keys = malloc(2 * g->key_words * sizeof(uint64_t));
+    g->count_shards = count_shards;
+    g->shards = malloc(count_shards * sizeof(hgraph_shard));
+
+    for (uint64_t i = 0; i < count_shards; i++)
+    {
+        g->shards[i].vertices = htable_create(g->key_words);
+        g->shards[i].arena = harena_create();
+        g->shards[i].count_edges = 0;
+        g->shards[i].filter = NULL;
+        g->shards[i].count_balanced_vertices = 0;
+        g->shards[i].count_semi_balanced_vertices = 0;
+        g->shards[i].count_generic_vertices = 0;
+        g->shards[i].sources = 0;
+        g->shards[i].sinks = 0;
+        g->shards[i].source_keys = calloc(g->key_words, sizeof(uint64_t));
+        g->shards[i].sink_keys = calloc(g->key_words, sizeof(uint64_t));
+        g->shards[i].stale = false;
+    }
+
+    return g;
+}
+
+/**
+ * @param k The length of the k-mers, must be greater than 1
+ * @param count_vertices The maximum number of vertices of the graph
+ * @return An empty hague graph whose vertices are (k-1)-mers
+ *
+ * The vertices are stored in a single fixed table, which can't grow past count_vertices vertices
+ */
+hgraph*
+hgraph_create_concurrent(uint64_t k, uint64_t count_vertices)
+{
+    hgraph* g = hgraph_create_sharded(k, 1);
+
+    htable_destroy(g->shards[0].vertices);
+    g->shards[0].vertices = htable_create_fixed(g->key_words, count_vertices);
+
+    return g;
+}
+
+/**
+ * @param g An initialized hague graph without k-mer filters
+ * @param min_count The number of occurrences of a k-mer before its edge is added, greater than 1 and less than 255
+ * @param count_counters The total number of counters of the filters, e.g. the number of k-mers of the input
+ *
+ * Each shard gets a counting Bloom filter of the k-mers starting from its vertices, so k-mers occurring less than
+ * min_count times (e.g. sequencing errors) never allocate a vertex. When a k-mer reaches min_count occurrences its
+ * edge is added with multiplicity min_count, then once for each occurrence. A k-mer sharing every counter of the
+ * filter with other k-mers may be added earlier, and then counted more times than it occurs, never later
+ */
+void
+hgraph_create_kmer_filters(hgraph* g, uint64_t min_count, uint64_t count_counters)
+{
+    assert_graph_init(g);
+    assert(min_count > 1 && min_count < UINT8_MAX && "Minimum count must be between 2 and 254");
+
+    g->min_count = min_count;
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        assert(g->shards[i].filter == NULL && "k-mers are already filtered");
+        g->shards[i].filter = hbloom_create(count_counters / g->count_shards);
+    }
+}
+
+/**
+ * @param g An initialized hague graph
+ */
+void
+hgraph_destroy_kmer_filters(hgraph* g)
+{
+    assert_graph_init(g);
+
+    g->min_count = 1;
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        if (g->shards[i].filter != NULL)
+        {
+            hbloom_destroy(g->shards[i].filter);
+            g->shards[i].filter = NULL;
+        }
+    }
+}
+
+/**
+ *  @param g An initialized hague graph
+ *  @return Number of vertices in g
+ */
+uint64_t
+hgraph_vertex_count(hgraph* g)
+{
+    assert_graph_init(g);
+
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        count += g->shards[i].vertices->count;
+    }
+
+    return count;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return Number of edges in g
+ */
+uint64_t
+hgraph_edge_count(hgraph* g)
+{
+    assert_graph_init(g);
+
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        count += g->shards[i].count_edges;
+    }
+
+    return count;
+}
+
+/**
+ *  @param g An initialized hague graph
+ *  @param key The packed label of the vertex, the smallest of a (k-1)-mer and its reverse complement if g is canonical
+ *  @return An hague vertex if g has a vertex with label "key", NULL otherwise
+ */
+hgraph_vertex*
+hgraph_get_vertex(hgraph* g, uint64_t* key)
+{
+    assert_graph_init(g);
+
+    return htable_get(g->shards[hgraph_shard_index(g, key)].vertices, key);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param key The packed label of the vertex
+ * @return The hague vertex with label "key", created if g doesn't have it yet
+ */
+hgraph_vertex*
+hgraph_add_vertex(hgraph* g, uint64_t* key)
+{
+    assert_graph_init(g);
+
+    return hgraph_shard_add_vertex(&g->shards[hgraph_shard_index(g, key)], key);
+}
+
+/**
+ * @param shard The shard of an hague graph that key belongs to
+ * @param key The packed label of the vertex
+ * @return The hague vertex with label "key", created if the shard doesn't have it yet
+ */
+hgraph_vertex*
+hgraph_shard_add_vertex(hgraph_shard* shard, uint64_t* key)
+{
+    bool inserted;
+    hgraph_vertex** slot = (hgraph_vertex**) htable_insert(shard->vertices, key, &inserted);
+    if (inserted)
+    {
+        hgraph_vertex* v = harena_alloc(shard->arena, sizeof(hgraph_vertex));
+        memset(v, 0, sizeof(hgraph_vertex));
+
+        *slot = v;
+        shard->count_balanced_vertices++;
+    }
+
+    return *slot;
+}
+
+/**
+ *  Return the outdegree of vertex v minus its indegree
+ */
+static inline int64_t
+vertex_balance(hgraph_vertex* v)
+{
+    return (int64_t) hgraph_vertex_outdegree(v) - (int64_t) hgraph_vertex_indegree(v);
+}
+
+/**
+ *  Add count, 1 or -1, to the class of the vertex v of shard with the given key and balance. Sources and sinks
+ *  are added to and removed from the XOR of their class in the same way
+ */
+static inline void
+classify_vertex(hgraph_shard* shard, hgraph_vertex* v, const uint64_t* key, int64_t balance, int64_t count)
+{
+    if (balance == 0)
+    {
+        shard->count_balanced_vertices += count;
+    }
+    else if (balance == 1 || balance == -1)
+    {
+        shard->count_semi_balanced_vertices += count;
+
+        uint64_t* keys = balance == 1 ? shard->source_keys : shard->sink_keys;
+        for (uint64_t w = 0; w < shard->vertices->key_words; w++)
+        {
+            keys[w] ^= key[w];
+        }
+
+        if (balance == 1)
+        {
+            shard->sources ^= (uintptr_t) v;
+        }
+        else
+        {
+            shard->sinks ^= (uintptr_t) v;
+        }
+    }
+    else
+    {
+        shard->count_generic_vertices += count;
+    }
+}
+
+/**
+ *  Move the vertex v of shard with the given key from the class of balance before to the class of balance after
+ */
+static inline void
+update_vertex_class(hgraph_shard* shard, hgraph_vertex* v, const uint64_t* key, int64_t before, int64_t after)
+{
+    classify_vertex(shard, v, key, before, -1);
+    classify_vertex(shard, v, key, after, 1);
+}
+
+/**
+ *  Add multiplicity outgoing edges through base to vertex v
+ */
+static inline void
+add_outgoing(hgraph_vertex* v, uint8_t base, uint32_t multiplicity)
+{
+    assert(hgraph_vertex_outdegree(v) <= UINT32_MAX - multiplicity && "Vertex degree overflow");
+
+    v->out_multiplicity[base] += multiplicity;
+    v->successors |= 1 << base;
+}
+
+/**
+ *  Add multiplicity incoming edges from the predecessor starting with base to vertex v
+ */
+static inline void
+add_incoming(hgraph_vertex* v, uint8_t base, uint32_t multiplicity)
+{
+    assert(hgraph_vertex_indegree(v) <= UINT32_MAX - multiplicity && "Vertex degree overflow");
+
+    v->in_multiplicity[base] += multiplicity;
+    v->predecessors |= 1 << base;
+}
+
+/**
+ * @param shard The shard of an hague graph that start belongs to
+ * @param start Packed label of the starting node
+ * @param last Last base of the label of the ending node, with HGRAPH_REVERSE if start is reverse complemented
+ * @param multiplicity The number of times the edge is added
+ * @return The starting vertex of the edge
+ *
+ * The successor is not linked, see hgraph_link_shard. An edge leaving the reverse complement of start is an edge
+ * entering start from the complement of last
+ */
+hgraph_vertex*
+hgraph_shard_add_edge_start(hgraph_shard* shard, uint64_t* start, uint8_t last, uint32_t multiplicity)
+{
+    hgraph_vertex* v_s = hgraph_shard_add_vertex(shard, start);
+    int64_t balance = vertex_balance(v_s);
+
+    if (last & HGRAPH_REVERSE)
+    {
+        add_incoming(v_s, hkmer_complement_base(last & 3), multiplicity);
+        update_vertex_class(shard, v_s, start, balance, balance - multiplicity);
+    }
+    else
+    {
+        add_outgoing(v_s, last, multiplicity);
+        update_vertex_class(shard, v_s, start, balance, balance + multiplicity);
+    }
+    shard->count_edges += multiplicity;
+
+    return v_s;
+}
+
+/**
+ * @param shard The shard of an hague graph that end belongs to
+ * @param end Packed label of the ending node
+ * @param first First base of the label of the starting node, with HGRAPH_REVERSE if end is reverse complemented
+ * @param multiplicity The number of times the edge is added
+ * @return The ending vertex of the edge
+ *
+ * An edge entering the reverse complement of end is an edge leaving end through the complement of first
+ */
+hgraph_vertex*
+hgraph_shard_add_edge_end(hgraph_shard* shard, uint64_t* end, uint8_t first, uint32_t multiplicity)
+{
+    hgraph_vertex* v_e = hgraph_shard_add_vertex(shard, end);
+    int64_t balance = vertex_balance(v_e);
+
+    if (first & HGRAPH_REVERSE)
+    {
+        add_outgoing(v_e, hkmer_complement_base(first & 3), multiplicity);
+        update_vertex_class(shard, v_e, end, balance, balance + multiplicity);
+    }
+    else
+    {
+        add_incoming(v_e, first, multiplicity);
+        update_vertex_class(shard, v_e, end, balance, balance - multiplicity);
+    }
+
+    return v_e;
+}
+
+/**
+ *  Return the smallest of key and its reverse complement reverse, setting flag to HGRAPH_REVERSE if it is reverse
+ */
+static inline uint64_t*
+canonical_key(hgraph* g, uint64_t* key, uint64_t* reverse, uint8_t* flag)
+{
+    bool forward = hkmer_compare(key, reverse, g->key_words) <= 0;
+    *flag = forward ? 0 : HGRAPH_REVERSE;
+
+    return forward ? key : reverse;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param start Packed label of the starting node
+ * @param end Packed label of the ending node
+ * @param reverse_keys Scratch buffer of 2 keys
+ * @param start_key Set to the key the outgoing side of the edge is added to
+ * @param last Set to the base of the outgoing side, see hgraph_shard_add_edge_start
+ * @param end_key Set to the key the incoming side of the edge is added to
+ * @param first Set to the base of the incoming side, see hgraph_shard_add_edge_end
+ *
+ * In a canonical graph the edge is replaced by its reverse complement if it is smaller, then each side goes to
+ * the canonical key of its vertex. Keys are set to start, end or reverse_keys
+ */
+void
+hgraph_orient_edge(hgraph* g, uint64_t* start, uint64_t* end, uint64_t* reverse_keys, uint64_t** start_key,
+                   uint8_t* last, uint64_t** end_key, uint8_t* first)
+{
+    uint64_t key_length = g->k - 1;
+    uint8_t l = end[g->key_words - 1] & 3;
+    uint8_t f = hkmer_base_at(start, key_length, 0);
+
+    if (!g->canonical)
+    {
+        *start_key = start;
+        *last = l;
+        *end_key = end;
+        *first = f;
+        return;
+    }
+
+    uint64_t* reverse_start = reverse_keys;
+    uint64_t* reverse_end = &reverse_keys[g->key_words];
+    hkmer_reverse_complement(start, key_length, reverse_start);
+    hkmer_reverse_complement(end, key_length, reverse_end);
+
+    // The reverse complement of the edge goes from the reverse complement of end to the one of start
+    int order = hkmer_compare(start, reverse_end, g->key_words);
+    if (order == 0)
+    {
+        order = (int) l - hkmer_complement_base(f);
+    }
+
+    uint8_t flag;
+    if (order <= 0)
+    {
+        *start_key = canonical_key(g, start, reverse_start, &flag);
+        *last = l | flag;
+        *end_key = canonical_key(g, end, reverse_end, &flag);
+        *first = f | flag;
+    }
+    else
+    {
+        *start_key = canonical_key(g, reverse_end, end, &flag);
+        *last = hkmer_complement_base(f) | flag;
+        *end_key = canonical_key(g, reverse_start, start, &flag);
+        *first = hkmer_complement_base(l) | flag;
+    }
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param start The key the outgoing side of the edge is added to
+ * @param last The base of the outgoing side, see hgraph_shard_add_edge_start
+ * @param keys Scratch buffer of 2 keys
+ * @param end_key Set to the key the incoming side of the edge is added to, one of keys
+ * @param first Set to the base of the incoming side, see hgraph_shard_add_edge_end
+ */
+void
+hgraph_edge_end(hgraph* g, const uint64_t* start, uint8_t last, uint64_t* keys, uint64_t** end_key, uint8_t* first)
+{
+    uint64_t key_length = g->k - 1;
+    uint64_t* end = keys;
+    uint64_t* reverse_end = &keys[g->key_words];
+
+    // Starting key of the edge as read on its strand
+    if (last & HGRAPH_REVERSE)
+    {
+        hkmer_reverse_complement(start, key_length, end);
+    }
+    else
+    {
+        memcpy(end, start, g->key_words * sizeof(uint64_t));
+    }
+
+    uint8_t f = hkmer_base_at(end, key_length, 0);
+    hkmer_push_back(end, key_length, last & 3);
+
+    uint8_t flag = 0;
+    if (g->canonical)
+    {
+        hkmer_reverse_complement(end, key_length, reverse_end);
+        end = canonical_key(g, end, reverse_end, &flag);
+    }
+
+    *end_key = end;
+    *first = f | flag;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param start Packed label of starting node
+ * @param end Packed label of ending node
+ * @return The starting vertex of the edge, NULL if its k-mer is filtered and hasn't occurred min_count times yet
+ *
+ * The label of the edge is obtained concatenating the label of the starting node and the last
+ * base of the label of the ending node. Adding an edge that already exists increments its multiplicity
+ */
+hgraph_vertex*
+hgraph_add_edge(hgraph* g, uint64_t* start, uint64_t* end)
+{
+    assert_graph_init(g);
+
+    uint8_t last; // last base of the ending node
+    uint8_t first; // first base of the starting node
+    hgraph_orient_edge(g, start, end, g->reverse_keys, &start, &last, &end, &first);
+
+    hgraph_shard* shard_s = &g->shards[hgraph_shard_index(g, start)];
+    uint32_t multiplicity = hgraph_shard_filter_kmer(g, shard_s, start, last);
+    if (multiplicity == 0)
+    {
+        return NULL;
+    }
+
+    hgraph_vertex* v_s = hgraph_shard_add_edge_start(shard_s, start, last, multiplicity);
+    hgraph_vertex* v_e = hgraph_shard_add_edge_end(&g->shards[hgraph_shard_index(g, end)], end, first, multiplicity);
+
+    // Link whichever sides are outgoing, a flipped successor is reached on its reverse complement
+    if (!(last & HGRAPH_REVERSE))
+    {
+        hgraph_vertex_link(v_s, last, v_e, first & HGRAPH_REVERSE);
+    }
+    if (first & HGRAPH_REVERSE)
+    {
+        hgraph_vertex_link(v_e, hkmer_complement_base(first & 3), v_s, (last & HGRAPH_REVERSE) ^ HGRAPH_REVERSE);
+    }
+
+    return v_s;
+}
+
+/**
+ *  Thread-safe version of hgraph_shard_add_vertex, for shards with a fixed table
+ */
+static hgraph_vertex*
+shard_add_vertex_concurrent(hgraph_shard* shard, uint64_t* key)
+{
+    bool inserted;
+    void** slot = htable_claim(shard->vertices, key, &inserted);
+    if (inserted)
+    {
+        hgraph_vertex* v = harena_alloc_concurrent(shard->arena, sizeof(hgraph_vertex));
+        memset(v, 0, sizeof(hgraph_vertex));
+
+        htable_publish(slot, v);
+        return v;
+    }
+
+    return *slot;
+}
+
+/**
+ * @param g An hague graph created by hgraph_create_concurrent
+ * @param start Packed label of starting node
+ * @param end Packed label of ending node
+ * @return The starting vertex of the edge
+ *
+ * Several threads can add edges at the same time: vertices are inserted with compare and swap operations and
+ * their counters are updated atomically, no lock is taken. The graph must not be read before every thread is done.
+ * Vertices are not classified by the balance of their degrees, which is left to
+ * hgraph_compute_eulerian_path_properties
+ */
+hgraph_vertex*
+hgraph_add_edge_concurrent(hgraph* g, uint64_t* start, uint64_t* end)
+{
+    assert_graph_init(g);
+    assert(g->min_count == 1 && "k-mers can't be filtered by concurrent insertions");
+    assert(!g->canonical && "Canonical graphs can't be built by concurrent insertions");
+
+    uint8_t last = end[g->key_words - 1] & 3; // last base of the ending node
+    uint8_t first = hkmer_base_at(start, g->k - 1, 0); // first base of the starting node
+
+    hgraph_shard* shard_s = &g->shards[hgraph_shard_index(g, start)];
+    hgraph_shard* shard_e = &g->shards[hgraph_shard_index(g, end)];
+
+    hgraph_vertex* v_s = shard_add_vertex_concurrent(shard_s, start);
+    hgraph_vertex* v_e = shard_add_vertex_concurrent(shard_e, end);
+
+    uint32_t out = __atomic_fetch_add(&v_s->out_multiplicity[last], 1, __ATOMIC_RELAXED);
+    uint32_t in = __atomic_fetch_add(&v_e->in_multiplicity[first], 1, __ATOMIC_RELAXED);
+    assert(out < UINT32_MAX && in < UINT32_MAX && "Vertex degree overflow");
+
+    __atomic_fetch_or(&v_s->successors, 1 << last, __ATOMIC_RELAXED);
+    __atomic_store_n(&v_s->next[last], v_e, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&v_e->predecessors, 1 << first, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&shard_s->count_edges, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard_s->stale, true, __ATOMIC_RELAXED);
+
+    return v_s;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param i The index of a shard of g
+ *
+ * Set the successor pointers of the vertices of a shard, for edges added one side at a time. Other shards are
+ * only read, so different shards can be linked concurrently once every edge has been added
+ */
+void
+hgraph_link_shard(hgraph* g, uint64_t i)
+{
+    assert_graph_init(g);
+
+    htable* vertices = g->shards[i].vertices;
+    uint64_t* successor = malloc(g->key_words * sizeof(uint64_t));
+    uint64_t* reverse = malloc(g->key_words * sizeof(uint64_t));
+
+    for (uint64_t j = 0; j < vertices->capacity; j++)
+    {
+        hgraph_vertex* v = vertices->values[j];
+        if (v == NULL)
+        {
+            continue;
+        }
+
+        for (uint8_t base = 0; base < 4; base++)
+        {
+            if (hgraph_vertex_has_successor(v, base))
+            {
+                memcpy(successor, htable_key_at(vertices, j), g->key_words * sizeof(uint64_t));
+                hkmer_push_back(successor, g->k - 1, base);
+
+                uint64_t* key = successor;
+                uint8_t flag = 0;
+                if (g->canonical)
+                {
+                    hkmer_reverse_complement(successor, g->k - 1, reverse);
+                    key = canonical_key(g, successor, reverse, &flag);
+                }
+
+                hgraph_vertex_link(v, base, hgraph_get_vertex(g, key), flag);
+            }
+        }
+    }
+
+    free(successor);
+    free(reverse);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param i The index of a shard of g
+ *
+ * Classify the vertices of a shard by the balance of their degrees from scratch, for shards whose degrees have
+ * been set without hgraph_shard_add_edge_start and hgraph_shard_add_edge_end, e.g. when loading a saved graph
+ */
+void
+hgraph_count_shard(hgraph* g, uint64_t i)
+{
+    assert_graph_init(g);
+
+    hgraph_shard* shard = &g->shards[i];
+    shard->count_balanced_vertices = 0;
+    shard->count_semi_balanced_vertices = 0;
+    shard->count_generic_vertices = 0;
+    shard->sources = 0;
+    shard->sinks = 0;
+    memset(shard->source_keys, 0, g->key_words * sizeof(uint64_t));
+    memset(shard->sink_keys, 0, g->key_words * sizeof(uint64_t));
+
+    for (uint64_t j = 0; j < shard->vertices->capacity; j++)
+    {
+        hgraph_vertex* v = shard->vertices->values[j];
+        if (v != NULL)
+        {
+            classify_vertex(shard, v, htable_key_at(shard->vertices, j), vertex_balance(v), 1);
+        }
+    }
+
+    shard->stale = false;
+}
+
+/**
+ * @param g An initialized hague graph
+ *
+ * Remove the graph from memory
+ */
+void
+hgraph_destroy(hgraph* g)
+{
+    assert_graph_init(g);
+
+    hgraph_destroy_kmer_filters(g);
+
+    // Vertices only live in the arenas, no need to visit them
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        harena_destroy(g->shards[i].arena);
+        htable_destroy(g->shards[i].vertices);
+        free(g->shards[i].source_keys);
+        free(g->shards[i].sink_keys);
+    }
+    free(g->shards);
+    free(g->reverse_keys);
+    free(g->walk_start_key);
+    free(g->walk_end_key);
+    free(g);
+}
+
+/**
+ *  Set the number of balanced, semi-balanced and generic vertices of g, summed over its shards
+ */
+static void
+count_vertices_by_type(hgraph* g, uint64_t* balanced, uint64_t* semi_balanced, uint64_t* generic)
+{
+    *balanced = 0;
+    *semi_balanced = 0;
+    *generic = 0;
+
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        *balanced += g->shards[i].count_balanced_vertices;
+        *semi_balanced += g->shards[i].count_semi_balanced_vertices;
+        *generic += g->shards[i].count_generic_vertices;
+    }
+}
+
+/**
+ *  Set the starting and ending vertex of the eulerian walk of g and their keys, to NULL if there is no walk. A
+ *  path goes from the only source to the only sink, given by the XOR of the sources and sinks of the shards. A
+ *  cycle starts from the first vertex in the order of the shards then of their slots
+ */
+static void
+find_walk_ends(hgraph* g)
+{
+    uint64_t key_size = g->key_words * sizeof(uint64_t);
+    g->walk_start_vertex = NULL;
+    g->walk_end_vertex = NULL;
+
+    if (hgraph_has_eulerian_cycle(g))
+    {
+        for (uint64_t s = 0; s < g->count_shards && g->walk_start_vertex == NULL; s++)
+        {
+            htable* vertices = g->shards[s].vertices;
+
+            for (uint64_t i = 0; i < vertices->capacity; i++)
+            {
+                if (vertices->values[i] != NULL)
+                {
+                    g->walk_start_vertex = vertices->values[i];
+                    g->walk_end_vertex = g->walk_start_vertex;
+                    memcpy(g->walk_start_key, htable_key_at(vertices, i), key_size);
+                    memcpy(g->walk_end_key, g->walk_start_key, key_size);
+                    break;
+                }
+            }
+        }
+    }
+    else if (hgraph_has_eulerian_path(g))
+    {
+        uintptr_t sources = 0;
+        uintptr_t sinks = 0;
+        memset(g->walk_start_key, 0, key_size);
+        memset(g->walk_end_key, 0, key_size);
+
+        for (uint64_t s = 0; s < g->count_shards; s++)
+        {
+            hgraph_shard* shard = &g->shards[s];
+            sources ^= shard->sources;
+            sinks ^= shard->sinks;
+
+            for (uint64_t w = 0; w < g->key_words; w++)
+            {
+                g->walk_start_key[w] ^= shard->source_keys[w];
+                g->walk_end_key[w] ^= shard->sink_keys[w];
+            }
+        }
+
+        g->walk_start_vertex = (hgraph_vertex*) sources;
+        g->walk_end_vertex = (hgraph_vertex*) sinks;
+    }
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return The eulerian walk starting vertex if exists, NULL otherwise
+ *
+ * The vertex is found from the classification of the vertices kept by the shards, so it is up to date with the
+ * edges added so far
+ */
+hgraph_vertex*
+hgraph_eulerian_walk_start(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+    find_walk_ends(g);
+
+    return g->walk_start_vertex;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return The eulerian walk ending vertex if exists, NULL otherwise
+ *
+ * The vertex is found from the classification of the vertices kept by the shards, so it is up to date with the
+ * edges added so far
+ */
+hgraph_vertex*
+hgraph_eulerian_walk_end(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+    find_walk_ends(g);
+
+    return g->walk_end_vertex;
+}
+
+/**
+ * @param g An initialized hague graph
+ *
+ * Set the starting and ending node of the eulerian walk(if exists). Vertices are classified as balanced,
+ * semi-balanced or generic while edges are added, so only shards whose degrees have been changed concurrently
+ * are visited. Calling it again gives the same result, which stays up to date when more edges are added
+ */
+void
+hgraph_compute_eulerian_path_properties(hgraph* g)
+{
+    assert_graph_init(g);
+    assert(!g->canonical && "Eulerian walks need a graph of the forward strand");
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        if (g->shards[s].stale)
+        {
+            hgraph_count_shard(g, s);
+        }
+    }
+
+    find_walk_ends(g);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return True, if g has eulerian path, false otherwise
+ */
+bool
+hgraph_has_eulerian_path(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+
+    uint64_t balanced, semi_balanced, generic;
+    count_vertices_by_type(g, &balanced, &semi_balanced, &generic);
+    bool is_semi_eulerian = (semi_balanced == 2) && (generic == 0);
+
+    return is_semi_eulerian;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return True, if g has eulerian cycle, false otherwise
+ */
+bool
+hgraph_has_eulerian_cycle(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+
+    uint64_t balanced, semi_balanced, generic;
+    count_vertices_by_type(g, &balanced, &semi_balanced, &generic);
+    bool is_eulerian = (generic == 0) && (semi_balanced == 0);
+
+    return is_eulerian;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return True, if eulerian properties have already been computed on g, false otherwise
+ */
+bool
+hgraph_has_eulerian_properties(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+
+    return hgraph_has_eulerian_path(g) || hgraph_has_eulerian_cycle(g);
+}
+
+/**
+ *  Return the base of the next edge of v to follow in the eulerian walk, 4 if every edge of v has been followed
+ */
+static inline uint8_t
+next_walk_base(hgraph_vertex* v)
+{
+    uint64_t j = v->next_neighbour;
+
+    for (uint8_t base = 0; base < 4; base++)
+    {
+        if (j < v->out_multiplicity[base])
+        {
+            return base;
+        }
+        j -= v->out_multiplicity[base];
+    }
+
+    return 4;
+}
+
+/**
+ *  Set to 0 the number of followed edges of every vertex of g, so that a new eulerian walk can be computed
+ */
+static void
+reset_walk(hgraph* g)
+{
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v != NULL)
+            {
+                v->next_neighbour = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @param w A graph seen through its accessors
+ * @param sink Destination of the walk
+ * @return True if the walk has been given to sink, false if the edges of w can't be covered by a single walk
+ *
+ * The walk is computed with Hierholzer's algorithm in O(V + E) time, using an explicit stack of at most E + 1
+ * steps allocated upfront instead of recursion. Its characters are given to sink in chunks of at most
+ * HGRAPH_WALK_CHUNK characters as soon as they are found, so the walk is never held in memory, even when the label
+ * of a single edge is longer than a chunk. Some chunks may have been given when false is returned
+ */
+bool
+hgraph_walk(hgraph_walker* w, hgraph_walk_sink* sink)
+{
+    uint64_t key_length = w->key_length;
+    uint64_t chunk_length = key_length + 1 > HGRAPH_WALK_CHUNK ? key_length + 1 : HGRAPH_WALK_CHUNK;
+
+    char* chunk = malloc(chunk_length * sizeof(char));
+    uint64_t* stack = malloc((w->count_steps + 1) * sizeof(uint64_t));
+    assert(chunk != NULL && stack != NULL && "Could not allocate eulerian walk");
+
+    uint64_t top = 0;
+    stack[top++] = w->start;
+
+    // Steps are popped when all the edges of their vertex have been followed, which happens in reverse walk order,
+    // so the label of each edge is written from the end of the chunk, which holds the characters from position
+    uint64_t position = w->length;
+    uint64_t filled = 0;
+
+    while (top > 0)
+    {
+        uint64_t next = w->successor(w->graph, stack[top - 1]);
+
+        if (next != HGRAPH_WALK_NONE)
+        {
+            stack[top++] = next;
+            continue;
+        }
+
+        top--;
+        if (top == 0)
+        {
+            break;
+        }
+
+        uint64_t length;
+        const char* label = w->label(w->graph, stack[top], &length);
+
+        while (length > 0)
+        {
+            if (filled == HGRAPH_WALK_CHUNK)
+            {
+                sink->write(sink, &chunk[chunk_length - filled], filled, position);
+                filled = 0;
+            }
+
+            uint64_t n = length < HGRAPH_WALK_CHUNK - filled ? length : HGRAPH_WALK_CHUNK - filled;
+            length -= n;
+            filled += n;
+            position -= n;
+            memcpy(&chunk[chunk_length - filled], &label[length], n);
+        }
+    }
+
+    free(stack);
+
+    // Some edges are not reachable from the starting vertex
+    bool connected = position == key_length;
+
+    // The walk spells the key of the starting vertex followed by the labels of the edges
+    if (connected)
+    {
+        if (filled > 0)
+        {
+            sink->write(sink, &chunk[chunk_length - filled], filled, position);
+        }
+
+        hkmer_decode(w->start_key, key_length, chunk);
+        sink->write(sink, chunk, key_length, 0);
+    }
+
+    free(chunk);
+
+    return connected;
+}
+
+/**
+ *  Copy a chunk of an eulerian walk to the string given as context of sink
+ */
+static void
+write_walk_string(hgraph_walk_sink* sink, const char* chunk, uint64_t length, uint64_t offset)
+{
+    char* result = sink->context;
+    memcpy(&result[offset], chunk, length);
+}
+
+/**
+ * @param w A graph seen through its accessors
+ * @return A string containing the concatenation of edge labels, from eulerian walk starting node to ending node,
+ *         NULL if the edges of w can't be covered by a single walk
+ *
+ * The walk is computed like hgraph_walk, into a string of the length of the walk
+ */
+char*
+hgraph_walk_string(hgraph_walker* w)
+{
+    char* result = malloc(w->length * sizeof(char) + 1);
+    assert(result != NULL && "Could not allocate eulerian walk");
+
+    hgraph_walk_sink sink;
+    sink.write = write_walk_string;
+    sink.context = result;
+
+    if (!hgraph_walk(w, &sink))
+    {
+        free(result);
+        return NULL;
+    }
+
+    result[w->length] = '\0';
+
+    return result;
+}
+
+/**
+ *  Write a chunk of an eulerian walk at its offset in the hgraph_walk_file given as context of sink
+ */
+static void
+write_walk_file(hgraph_walk_sink* sink, const char* chunk, uint64_t length, uint64_t offset)
+{
+    hgraph_walk_file* f = sink->context;
+
+    uint64_t written = 0;
+    while (written < length)
+    {
+        ssize_t n = pwrite(f->fd, &chunk[written], length - written, f->offset + offset + written);
+        assert(n > 0 && "Could not write eulerian walk");
+        written += n;
+    }
+}
+
+/**
+ *  Write the eulerian walk of w to the seekable file fd from offset, then move the file offset after the walk.
+ *  If there is no walk the file is truncated back to offset. Return true if the walk has been written
+ */
+static bool
+export_walk_at(hgraph_walker* w, int fd, uint64_t offset)
+{
+    hgraph_walk_file f;
+    f.fd = fd;
+    f.offset = offset;
+
+    hgraph_walk_sink sink;
+    sink.write = write_walk_file;
+    sink.context = &f;
+
+    if (!hgraph_walk(w, &sink))
+    {
+        int error = ftruncate(fd, offset);
+        assert(error == 0 && "Could not truncate eulerian walk");
+        return false;
+    }
+
+    lseek(fd, offset + w->length, SEEK_SET);
+
+    return true;
+}
+
+/**
+ *  Return true if chunks can be written at their offset in fd, i.e. fd is a regular file not opened for appending,
+ *  since pwrite ignores the offset of an appended file
+ */
+static bool
+writes_at_offset(int fd)
+{
+    struct stat st;
+    int flags = fcntl(fd, F_GETFL);
+
+    return flags >= 0 && !(flags & O_APPEND) && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * @param w A graph seen through its accessors
+ * @param fd Descriptor of the output file, the console or a pipe
+ * @return True if the walk has been written, false if the edges of w can't be covered by a single walk
+ *
+ * Chunks of the walk are written to their offset in the file as soon as they are found, so memory doesn't depend
+ * on the length of the walk. Since they are found from the end of the walk, a walk to any other descriptor than a
+ * regular file, e.g. a pipe, or to a file opened for appending is first written to a temporary file, then copied
+ * to fd in chunks. Nothing is written if there is no walk
+ */
+bool
+hgraph_walk_export(hgraph_walker* w, int fd)
+{
+    off_t offset = writes_at_offset(fd) ? lseek(fd, 0, SEEK_CUR) : -1;
+    if (offset >= 0)
+    {
+        return export_walk_at(w, fd, offset);
+    }
+
+    FILE* tmp = tmpfile();
+    assert(tmp != NULL && "Could not create temporary eulerian walk");
+
+    bool connected = export_walk_at(w, fileno(tmp), 0);
+    if (connected)
+    {
+        char* chunk = malloc(HGRAPH_WALK_CHUNK * sizeof(char));
+        assert(chunk != NULL && "Could not allocate eulerian walk");
+
+        for (uint64_t copied = 0; copied < w->length;)
+        {
+            ssize_t n = pread(fileno(tmp), chunk, HGRAPH_WALK_CHUNK, copied);
+            assert(n > 0 && "Could not read temporary eulerian walk");
+
+            for (ssize_t written = 0; written < n;)
+            {
+                ssize_t m = write(fd, &chunk[written], n - written);
+                assert(m > 0 && "Could not write eulerian walk");
+                written += m;
+            }
+            copied += n;
+        }
+
+        free(chunk);
+    }
+
+    fclose(tmp);
+
+    return connected;
+}
+
+/**
+ *  Successor accessor of the walker of an hague graph. A step is a vertex pointer together with the base of the
+ *  edge used to reach it, packed in its low bits which are always 0 since vertices are 8 bytes aligned
+ */
+static uint64_t
+walk_successor(void* graph, uint64_t step)
+{
+    (void) graph;
+
+    hgraph_vertex* v = (hgraph_vertex*) (uintptr_t) (step & ~(uint64_t) 3);
+    uint8_t base = next_walk_base(v);
+
+    if (base == 4)
+    {
+        return HGRAPH_WALK_NONE;
+    }
+
+    v->next_neighbour++;
+
+    return (uintptr_t) v->next[base] | base;
+}
+
+/**
+ *  Label accessor of the walker of an hague graph, an edge appends its last base to the walk
+ */
+static const char*
+walk_label(void* graph, uint64_t step, uint64_t* length)
+{
+    (void) graph;
+    *length = 1;
+
+    return &"ACGT"[step & 3];
+}
+
+/**
+ *  Set w to walk g from the starting vertex of its eulerian walk and reset the followed edges of its vertices.
+ *  Return false if g has no eulerian path or cycle
+ */
+static bool
+init_walker(hgraph* g, hgraph_walker* w)
+{
+    hgraph_vertex* start = hgraph_eulerian_walk_start(g);
+    if (start == NULL)
+    {
+        return false;
+    }
+
+    reset_walk(g);
+
+    w->graph = g;
+    w->successor = walk_successor;
+    w->label = walk_label;
+    w->start = (uintptr_t) start;
+    w->start_key = g->walk_start_key;
+    w->key_length = g->k - 1;
+    w->count_steps = hgraph_edge_count(g);
+    w->length = w->count_steps + w->key_length;
+
+    return true;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param sink Destination of the walk
+ * @return True if the walk has been given to sink, false if the edges of g can't be covered by a single walk
+ *
+ * Eulerian properties must have been already computed on g. The walk is computed by hgraph_walk, the number of
+ * followed edges of each vertex being kept in its next_neighbour field
+ */
+bool
+hgraph_write_eulerian_walk(hgraph* g, hgraph_walk_sink* sink)
+{
+    assert_eulerian_properties_computed(g);
+
+    hgraph_walker w;
+    return init_walker(g, &w) && hgraph_walk(&w, sink);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @return A string containing the concatenation of edge labels, from eulerian walk starting node to ending node,
+ *         NULL if the edges of g can't be covered by a single walk
+ *
+ * Eulerian properties must have been already computed on g. The walk is computed like
+ * hgraph_write_eulerian_walk, into a string of E + k characters
+ */
+char*
+hgraph_compute_eulerian_walk(hgraph* g)
+{
+    assert_eulerian_properties_computed(g);
+
+    hgraph_walker w;
+    return init_walker(g, &w) ? hgraph_walk_string(&w) : NULL;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param fd Descriptor of the output file, the console or a pipe
+ * @return True if the walk has been written, false if the edges of g can't be covered by a single walk
+ *
+ * Eulerian properties must have been already computed on g. The walk is written like hgraph_walk_export, so
+ * memory doesn't depend on its length. Nothing is written if there is no walk
+ */
+bool
+hgraph_export_eulerian_walk(hgraph* g, int fd)
+{
+    assert_eulerian_properties_computed(g);
+
+    hgraph_walker w;
+    return init_walker(g, &w) && hgraph_walk_export(&w, fd);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param s A nucleotide sequence, not necessarily null terminated
+ * @param length The length of s
+ *
+ * Add an edge to g for each k-mer of s, k-mers containing anything else than nucleotides (e.g. N) are skipped
+ */
+void
+hgraph_add_sequence(hgraph* g, const char* s, uint64_t length)
+{
+    assert_graph_init(g);
+
+    hkmer_iter it;
+    hkmer_iter_init(&it, g->k);
+
+    for (uint64_t i = 0; i < length; i++)
+    {
+        if (hkmer_iter_next(&it, s[i]))
+        {
+            hgraph_add_edge(g, it.prefix, it.suffix);
+        }
+    }
+
+    hkmer_iter_destroy(&it);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param text FASTA text, not necessarily null terminated
+ * @param length The length of text
+ *
+ * Add an edge to g for each k-mer of each record of text, skipping line breaks. k-mers containing anything else
+ * than nucleotides (e.g. N) are skipped
+ */
+void
+hgraph_add_fasta(hgraph* g, const char* text, uint64_t length)
+{
+    assert_graph_init(g);
+
+    hkmer_iter it;
+    hkmer_iter_init(&it, g->k);
+
+    for (uint64_t i = 0; i < length; i++)
+    {
+        if (hkmer_iter_next_text(&it, text[i]))
+        {
+            hgraph_add_edge(g, it.prefix, it.suffix);
+        }
+    }
+
+    hkmer_iter_destroy(&it);
+}
+
+/**
+ * @param options Construction parameters to initialize
+ * @param k The length of the k-mer
+ */
+void
+hgraph_build_options_init(hgraph_build_options* options, uint64_t k)
+{
+    options->k = k;
+    options->threads = 1;
+    options->stats = NULL;
+    options->min_count = 1;
+    options->filter_counters = 0;
+    options->canonical = false;
+    options->sort = false;
+    options->max_memory = 0;
+    options->input_length = 0;
+    options->stream = NULL;
+    options->weighted = false;
+}
+
+/**
+ *  Create the graph built with the given options, with k-mer filters of count_counters counters unless their size
+ *  is given by the options. Sorted k-mers are counted exactly, so they are never filtered
+ */
+static hgraph*
+create_graph(hgraph_build_options* options, uint64_t count_counters)
+{
+    hgraph* g = hgraph_create_sharded(options->k, options->threads);
+    g->canonical = options->canonical;
+    if (options->min_count > 1 && !options->sort)
+    {
+        uint64_t counters = options->filter_counters > 0 ? options->filter_counters : count_counters;
+        hgraph_create_kmer_filters(g, options->min_count, counters);
+    }
+
+    return g;
+}
+
+/**
+ *  Return the number of characters of the batches read for graph g built by a given number of threads
+ */
+static uint64_t
+batch_capacity(hgraph* g, uint64_t threads)
+{
+    uint64_t capacity = threads > 1 ? hbuilder_batch_capacity(g) : HGRAPH_BATCH_LENGTH;
+
+    return capacity < 2 * g->k ? 2 * g->k : capacity;
+}
+
+/**
+ *  Add the k-mers of every batch of pipeline p to graph g, which has one shard for each thread
+ */
+static void
+add_batches(hgraph* g, pipeline* p, hgraph_build_options* options)
+{
+    uint64_t threads = options->threads;
+    if (options->sort)
+    {
+        hsort_add_batches(g, p, options);
+        return;
+    }
+
+    if (threads > 1)
+    {
+        hbuilder_add_batches(g, p, threads);
+        return;
+    }
+
+    bool validfile = false;
+    pipeline_batch* batch;
+    while ((batch = pipeline_acquire(p)) != NULL)
+    {
+        validfile = true;
+
+        if (p->text)
+        {
+            hgraph_add_fasta(g, batch->data, batch->length);
+        }
+        else
+        {
+            hgraph_add_sequence(g, batch->data, batch->length);
+        }
+        pipeline_release(p, batch);
+    }
+    assert(validfile && "Invalid file content");
+}
+
+/**
+ * @param seq A FASTA sequence parsed using kseq library
+ * @param options Construction parameters, see hgraph_build_options_init
+ * @return An empty hague graph if seq is not valid or an hague graph representing a De Bruijn graph otherwise
+ *
+ * Records are read and copied to batches by a dedicated thread while k-mers are added to the graph. With more
+ * than one thread, the graph has one shard for each thread and batches are processed by hbuilder_add_batches.
+ * With the sort option every k-mer is kept, or spilled to files under a memory budget, until the end of the input,
+ * then counted by hsort_add_batches
+ */
+hgraph*
+hgraph_create_de_bruijn_graph(kseq_t* seq, hgraph_build_options* options)
+{
+    uint64_t k = options->k;
+    uint64_t threads = options->threads;
+    assert(threads > 0 && "Number of threads must be greater than 0");
+
+    hgraph* g = create_graph(options, HGRAPH_FILTER_COUNTERS);
+    pipeline* p = pipeline_create(seq, batch_capacity(g, threads), k - 1, k, HGRAPH_PIPELINE_BUFFERS);
+    add_batches(g, p, options);
+    hgraph_destroy_kmer_filters(g);
+
+    if (options->stats != NULL)
+    {
+        *options->stats = p->stats;
+    }
+    pipeline_destroy(p);
+
+    return g;
+}
+
+/**
+ * @param filename Name of a FASTA file, gzip compressed or not
+ * @param options Construction parameters, see hgraph_build_options_init
+ * @return An hague graph representing a De Bruijn graph
+ *
+ * Uncompressed FASTA files are mapped in memory and k-mers are read directly from the mapped pages, without
+ * copying records. Compressed FASTA files are streamed in batches of bounded length, so a record is never held
+ * whole in memory. Other files, e.g. FASTQ, are read by kseq, see hgraph_create_de_bruijn_graph
+ */
+hgraph*
+hgraph_create_de_bruijn_graph_from_file(char* filename, hgraph_build_options* options)
+{
+    uint64_t threads = options->threads;
+    assert(threads > 0 && "Number of threads must be greater than 0");
+
+    mapped_fasta* m = mapped_fasta_open(filename);
+    if (m == NULL && fasta_input_detect(filename))
+    {
+        fasta_input* in = fasta_input_open(filename, threads);
+        hgraph_build_options sized = *options;
+        sized.input_length = fasta_input_estimate_length(filename);
+        hgraph* g = create_graph(&sized, sized.input_length / 2);
+
+        pipeline* p = pipeline_create_text(in, batch_capacity(g, threads), options->k - 1, HGRAPH_PIPELINE_BUFFERS);
+        add_batches(g, p, &sized);
+        hgraph_destroy_kmer_filters(g);
+
+        if (options->stats != NULL)
+        {
+            *options->stats = p->stats;
+        }
+        pipeline_destroy(p);
+        fasta_input_close(in);
+
+        return g;
+    }
+
+    if (m == NULL)
+    {
+        // Size the k-mer filter and the partitions from the file rather than with the defaults
+        hgraph_build_options sized = *options;
+        sized.input_length = fasta_input_estimate_length(filename);
+        if (sized.filter_counters == 0)
+        {
+            sized.filter_counters = sized.input_length / 2;
+        }
+
+        fasta_input* fp;
+        kseq_t* seq = read_fasta(filename, threads, &fp);
+        hgraph* g = hgraph_create_de_bruijn_graph(seq, &sized);
+
+        kseq_destroy(seq);
+        fasta_input_close(fp);
+
+        return g;
+    }
+
+    hgraph* g = create_graph(options, m->length / 2);
+    if (options->sort)
+    {
+        hsort_add_text(g, m->data, m->length, options);
+    }
+    else if (threads > 1)
+    {
+        hbuilder_add_text(g, m->data, m->length, threads);
+    }
+    else
+    {
+        hgraph_add_fasta(g, m->data, m->length);
+    }
+    hgraph_destroy_kmer_filters(g);
+
+    // Nothing is read ahead of the graph construction
+    if (options->stats != NULL)
+    {
+        memset(options->stats, 0, sizeof(pipeline_stats));
+    }
+
+    mapped_fasta_close(m);
+
+    return g;
+}
+
+/**
+ *  Set first and last to the range of slots of shard s of g in the given part of count_parts parts. Parts are
+ *  contiguous ranges of the slots of all the shards taken in order, so that they hold about as many slots each
+ */
+static void
+part_slots(hgraph* g, uint64_t part, uint64_t count_parts, uint64_t s, uint64_t* first, uint64_t* last)
+{
+    uint64_t total = 0;
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < g->count_shards; i++)
+    {
+        if (i == s)
+        {
+            offset = total;
+        }
+        total += g->shards[i].vertices->capacity;
+    }
+
+    uint64_t capacity = g->shards[s].vertices->capacity;
+    uint64_t start = total * part / count_parts;
+    uint64_t end = total * (part + 1) / count_parts;
+
+    *first = start > offset ? start - offset : 0;
+    *last = end > offset ? end - offset : 0;
+    *first = *first < capacity ? *first : capacity;
+    *last = *last < capacity ? *last : capacity;
+}
+
+/**
+ *  Write to o the edge of canonical graph g added count times whose outgoing side is base of the vertex stored as
+ *  key, reverse complemented if reverse, unless the edge is the incoming side of a smaller k-mer. If halve, count
+ *  holds both sides of a palindromic k-mer. keys is a scratch buffer of 3 keys, line a buffer of 3 k + 7 characters
+ */
+static void
+write_canonical_edge(hgraph* g, output* o, bool weighted, const uint64_t* key, bool reverse, uint8_t base,
+                     uint32_t count, bool halve, uint64_t* keys, char* line)
+{
+    uint64_t key_length = g->k - 1;
+    uint64_t* start = keys;
+    uint64_t* end = &keys[g->key_words];
+    uint64_t* reverse_end = &keys[2 * g->key_words];
+
+    if (reverse)
+    {
+        hkmer_reverse_complement(key, key_length, start);
+    }
+    else
+    {
+        memcpy(start, key, g->key_words * sizeof(uint64_t));
+    }
+
+    memcpy(end, start, g->key_words * sizeof(uint64_t));
+    hkmer_push_back(end, key_length, base);
+    hkmer_reverse_complement(end, key_length, reverse_end);
+
+    // The reverse complement of the edge starts with the reverse complement of end
+    int order = hkmer_compare(start, reverse_end, g->key_words);
+    if (order == 0)
+    {
+        order = (int) base - hkmer_complement_base(hkmer_base_at(start, key_length, 0));
+    }
+
+    if (order > 0)
+    {
+        return;
+    }
+
+    // Both sides of a palindromic k-mer are outgoing sides of the same vertex
+    if (order == 0 && halve)
+    {
+        count /= 2;
+    }
+
+    bool reverse_target = hkmer_compare(end, reverse_end, g->key_words) > 0;
+
+    // A line is "source, target, label, strands", each field followed by its separator, decoded in place
+    char* source = line;
+    char* target = &source[key_length + 2];
+    char* label = &target[key_length + 2];
+    char* strands = &label[key_length + 3];
+
+    hkmer_decode(key, key_length, source);
+    hkmer_decode(reverse_target ? reverse_end : end, key_length, target);
+    hkmer_decode(start, key_length, label);
+    label[key_length] = hkmer_decode_base(base);
+    memcpy(&source[key_length], ", ", 2);
+    memcpy(&target[key_length], ", ", 2);
+    memcpy(&label[key_length + 1], ", ", 2);
+    strands[0] = reverse ? '-' : '+';
+    strands[1] = reverse_target ? '-' : '+';
+    uint64_t length = &strands[2] - line;
+
+    if (weighted)
+    {
+        output_write(o, line, length);
+        output_write(o, ", ", 2);
+        output_uint(o, count);
+        output_char(o, '\n');
+        return;
+    }
+
+    strands[2] = '\n';
+    for (uint32_t i = 0; i < count; i++)
+    {
+        output_write(o, line, length + 1);
+    }
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param o An opened output
+ * @param weighted True if each distinct edge is written once with the number of times it has been added
+ */
+void
+hgraph_write_edges_header(hgraph* g, output* o, bool weighted)
+{
+    const char* header;
+    if (g->canonical)
+    {
+        header = weighted ? "Source, Target, Label, Strands, Weight\n" : "Source, Target, Label, Strands\n";
+    }
+    else
+    {
+        header = weighted ? "Source, Target, Label, Weight\n" : "Source, Target, Label\n";
+    }
+
+    output_write(o, header, strlen(header));
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param o An opened output
+ * @param weighted True to write the edge once with the number of times it has been added
+ * @param start The key the outgoing side of the edge is added to, see hgraph_orient_edge
+ * @param last The base of the outgoing side
+ * @param end The key the incoming side of the edge is added to
+ * @param first The base of the incoming side
+ * @param count The number of times the edge has been added
+ * @param keys Scratch buffer of 3 keys
+ * @param line Scratch buffer of 3 k + 7 characters
+ *
+ * The edge is written as the edges table of a graph it has been added to count times would write it, without
+ * adding it to g. Edges can then be written while they are counted, without holding the graph in memory
+ */
+void
+hgraph_write_edge(hgraph* g, output* o, bool weighted, const uint64_t* start, uint8_t last, const uint64_t* end,
+                  uint8_t first, uint32_t count, uint64_t* keys, char* line)
+{
+    uint64_t key_length = g->k - 1;
+
+    // Each side is written from the vertex it is added to, the one which doesn't start the smallest k-mer is skipped
+    if (g->canonical)
+    {
+        bool reverse = last & HGRAPH_REVERSE;
+        bool reverse_end = !(first & HGRAPH_REVERSE);
+        uint8_t base_end = hkmer_complement_base(first & 3);
+
+        // Both sides of a palindromic k-mer are the same outgoing side, written once with the whole count. Vertex
+        // keys have an odd length when k is even, so they are never palindromic and the sides have the same strand
+        bool palindrome = reverse == reverse_end && (last & 3) == base_end
+                          && hkmer_compare(start, end, g->key_words) == 0;
+
+        write_canonical_edge(g, o, weighted, start, reverse, last & 3, count, false, keys, line);
+        if (!palindrome)
+        {
+            write_canonical_edge(g, o, weighted, end, reverse_end, base_end, count, false, keys, line);
+        }
+        return;
+    }
+
+    char* source = line;
+    char* target = &source[key_length + 2];
+    char* label = &target[key_length + 2];
+    uint64_t length = 3 * key_length + 5;
+
+    hkmer_decode(start, key_length, source);
+    hkmer_decode(end, key_length, target);
+    hkmer_decode(start, key_length, label);
+    memcpy(&source[key_length], ", ", 2);
+    memcpy(&target[key_length], ", ", 2);
+    label[key_length] = hkmer_decode_base(last);
+
+    if (weighted)
+    {
+        output_write(o, line, length);
+        output_write(o, ", ", 2);
+        output_uint(o, count);
+        output_char(o, '\n');
+        return;
+    }
+
+    label[key_length + 1] = '\n';
+    for (uint32_t i = 0; i < count; i++)
+    {
+        output_write(o, line, length + 1);
+    }
+}
+
+/**
+ * @param o An opened output
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ * @param key The packed key of the vertex
+ * @param key_length The number of bases of the key
+ * @param out_multiplicity The number of times the edge through each base has been added, 0 if there is none
+ * @param line Scratch buffer of 3 (k - 1) + 6 characters
+ *
+ * Edges are written like the edges table of an hague graph of the forward strand writes them, so that graphs
+ * stored otherwise, e.g. images, write the same table from their own vertices
+ */
+void
+hgraph_write_vertex_edges(output* o, bool weighted, const uint64_t* key, uint64_t key_length,
+                          const uint32_t* out_multiplicity, char* line)
+{
+    // A line is "source, target, label", each field followed by its separator. The target is the source shifted
+    // by one base and the label the source followed by one base, so only their last base changes between edges
+    char* source = line;
+    char* target = &source[key_length + 2];
+    char* label = &target[key_length + 2];
+    uint64_t length = 3 * key_length + 5;
+
+    hkmer_decode(key, key_length, source);
+    memcpy(&source[key_length], ", ", 2);
+    memcpy(target, &source[1], key_length - 1);
+    memcpy(&target[key_length], ", ", 2);
+    memcpy(label, source, key_length);
+
+    for (uint8_t base = 0; base < 4; base++)
+    {
+        if (out_multiplicity[base] == 0)
+        {
+            continue;
+        }
+
+        target[key_length - 1] = hkmer_decode_base(base);
+        label[key_length] = target[key_length - 1];
+
+        if (weighted)
+        {
+            output_write(o, line, length);
+            output_write(o, ", ", 2);
+            output_uint(o, out_multiplicity[base]);
+            output_char(o, '\n');
+            continue;
+        }
+
+        // An edge added several times is written once for each time
+        label[key_length + 1] = '\n';
+        for (uint32_t i = 0; i < out_multiplicity[base]; i++)
+        {
+            output_write(o, line, length + 1);
+        }
+    }
+}
+
+/**
+ *  Write the edges of the given part of the slots of canonical graph g to o using Gephi "Edges table" notation,
+ *  with the strands of the source and the target, '+' if a vertex is read as stored and '-' if it is read as its
+ *  reverse complement
+ */
+static void
+write_canonical_edges_table(hgraph* g, output* o, bool weighted, uint64_t part, uint64_t count_parts)
+{
+    uint64_t* keys = malloc(3 * g->key_words * sizeof(uint64_t));
+    char* line = malloc(3 * g->k + 7);
+
+    hgraph_write_edges_header(g, o, weighted);
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+        uint64_t first, last;
+        part_slots(g, part, count_parts, s, &first, &last);
+
+        for (uint64_t j = first; j < last; j++)
+        {
+            hgraph_vertex* v = vertices->values[j];
+            if (v == NULL)
+            {
+                continue;
+            }
+
+            // Incoming edges of a vertex are the outgoing edges of its reverse complement
+            const uint64_t* key = htable_key_at(vertices, j);
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                if (v->out_multiplicity[base] > 0)
+                {
+                    write_canonical_edge(g, o, weighted, key, false, base, v->out_multiplicity[base], true, keys,
+                                         line);
+                }
+                if (v->in_multiplicity[base] > 0)
+                {
+                    write_canonical_edge(g, o, weighted, key, true, hkmer_complement_base(base),
+                                         v->in_multiplicity[base], true, keys, line);
+                }
+            }
+        }
+    }
+
+    free(keys);
+    free(line);
+}
+
+/**
+ *  Write the edges of the given part of the slots of graph g to o using Gephi "Edges table" notation, packed keys
+ *  are decoded here. If weighted, each distinct edge is written once with its multiplicity as weight
+ */
+static void
+write_edges_table(hgraph* g, output* o, bool weighted, uint64_t part, uint64_t count_parts)
+{
+    if (g->canonical)
+    {
+        write_canonical_edges_table(g, o, weighted, part, count_parts);
+        return;
+    }
+
+    uint64_t key_length = g->k - 1;
+    char* line = malloc(3 * key_length + 6);
+
+    hgraph_write_edges_header(g, o, weighted);
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+        uint64_t first, last;
+        part_slots(g, part, count_parts, s, &first, &last);
+
+        for (uint64_t j = first; j < last; j++)
+        {
+            hgraph_vertex* v = vertices->values[j];
+            if (v == NULL)
+            {
+                continue;
+            }
+
+            hgraph_write_vertex_edges(o, weighted, htable_key_at(vertices, j), key_length, v->out_multiplicity, line);
+        }
+    }
+
+    free(line);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param filename Name of the outpur file
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ */
+void
+hgraph_export_to_file(hgraph* g, char* filename, bool weighted)
+{
+    assert_graph_init(g);
+    output* o = output_open(filename);
+    write_edges_table(g, o, weighted, 0, 1);
+
+    output_close(o);
+}
+
+/**
+ *  Body of the threads of hgraph_export_to_files, each one writing its own part of the graph to its own file
+ */
+static void*
+export_part(void* arg)
+{
+    hgraph_export_part* p = arg;
+
+    output* o = output_open(p->filename);
+    write_edges_table(p->g, o, p->weighted, p->part, p->count_parts);
+    output_close(o);
+
+    return NULL;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param filename Prefix of the names of the output files, which are followed by a dot and the index of the part
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ * @param count_parts Number of files, each one written by its own thread, must be greater than 0
+ *
+ * The slots of the shards are split into count_parts contiguous ranges of about the same length. Each part starts
+ * with its own header and concatenating the parts without their headers gives the edges written by
+ * hgraph_export_to_file, in the same order
+ */
+void
+hgraph_export_to_files(hgraph* g, char* filename, bool weighted, uint64_t count_parts)
+{
+    assert_graph_init(g);
+    assert(count_parts > 0 && "Number of parts must be greater than 0");
+
+    hgraph_export_part* parts = malloc(count_parts * sizeof(hgraph_export_part));
+    uint64_t name_length = strlen(filename) + 22;
+
+    for (uint64_t i = 0; i < count_parts; i++)
+    {
+        parts[i].g = g;
+        parts[i].filename = malloc(name_length);
+        snprintf(parts[i].filename, name_length, "%s.%lu", filename, i);
+        parts[i].weighted = weighted;
+        parts[i].part = i;
+        parts[i].count_parts = count_parts;
+
+        if (i > 0)
+        {
+            int error = pthread_create(&parts[i].thread, NULL, export_part, &parts[i]);
+            assert(error == 0 && "Could not create export thread");
+        }
+    }
+
+    export_part(&parts[0]);
+
+    for (uint64_t i = 0; i < count_parts; i++)
+    {
+        if (i > 0)
+        {
+            pthread_join(parts[i].thread, NULL);
+        }
+        free(parts[i].filename);
+    }
+    free(parts);
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ */
+void
+hgraph_print_graph(hgraph* g, bool weighted)
+{
+    assert_graph_init(g);
+    output* o = output_open_stdout();
+    write_edges_table(g, o, weighted, 0, 1);
+
+    output_close(o);
+}
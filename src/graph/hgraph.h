@@ -9,68 +9,321 @@
 #include <stdio.h>
 #include "utils/initializer.h"
 #include "klib/kseq.h"
-#include "hash/uthash.h"
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/harena.h"
+#include "graph/hbloom.h"
+#include "io/pipeline.h"
+#include "io/mapped.h"
+#include "io/reader.h"
+#include "io/output.h"
+
+/**
+ * Flag of the base of an edge side, set when the side is added to the reverse complement of the stored vertex
+ */
+#define HGRAPH_REVERSE 4
+
+/**
+ * Maximum number of characters of an eulerian walk given to a sink at once
+ */
+#define HGRAPH_WALK_CHUNK ((uint64_t) 1 << 20)
+
+/**
+ * Step returned by the successor accessor of an hgraph_walker once every edge of a vertex has been followed
+ */
+#define HGRAPH_WALK_NONE UINT64_MAX
 
 typedef struct hgraph hgraph;
 
 typedef struct hgraph_vertex hgraph_vertex;
 
-typedef struct hgraph_edge hgraph_edge;
+typedef struct hgraph_shard hgraph_shard;
+
+typedef struct hgraph_build_options hgraph_build_options;
+
+typedef struct hgraph_export_part hgraph_export_part;
+
+typedef struct hgraph_walk_sink hgraph_walk_sink;
+
+typedef struct hgraph_walk_file hgraph_walk_file;
+
+typedef struct hgraph_walker hgraph_walker;
 
 /** @struct hgraph
     @brief A struct representing an "Hague Graph"
 
     An Hague Graph is a standard adjacency-list based graph enriched with fields useful
     for managing eulerian graphs.
+
+    A canonical graph stores the forward and reverse strands together: a vertex is the smallest of a (k-1)-mer and
+    its reverse complement and an edge is the smallest of a k-mer and its reverse complement, so each region of a
+    double stranded input is stored once. Vertices have two sides: the outgoing edges of the reverse complement of
+    a vertex are the incoming edges of the vertex, read on the other strand. This bidirected graph can be exported
+    but not walked.
 */
 struct hgraph
 {
-    uint64_t count_vertices; /**<  Number of vertices */
-    uint64_t count_edges; /**<  Number of edges */
-    uint64_t count_balanced_vertices; /**< Number of balanced vertices */
-    uint64_t count_semi_balanced_vertices; /**< Number of semi-balanced vertices */
-    uint64_t count_generic_vertices; /**< Number of vertices with different in/out edges */
+    uint64_t k; /**< Length of the k-mers, vertex keys are (k-1)-mers */
+    uint64_t key_words; /**< Number of words of a packed vertex key */
     hgraph_vertex* walk_start_vertex; /**< Starting vertex of Eulerian path (if exists) */
     hgraph_vertex* walk_end_vertex; /**< Ending vertex of Eulerian path (if exists) */
-    hgraph_vertex* vertices; /**< Map of vertices */
+    uint64_t* walk_start_key; /**< Packed key of the starting vertex of Eulerian path (if exists) */
+    uint64_t* walk_end_key; /**< Packed key of the ending vertex of Eulerian path (if exists) */
+    uint64_t min_count; /**< Number of occurrences of a k-mer before its edge is added, 1 if k-mers are not filtered */
+    bool canonical; /**< True if k-mers and their reverse complements are folded, must be set before adding edges */
+    uint64_t* reverse_keys; /**< Scratch buffer of hgraph_add_edge for two reverse complemented keys */
+    uint64_t count_shards; /**< Number of shards the vertices are partitioned into */
+    hgraph_shard* shards; /**< Shards of the vertices, the shard of a vertex is selected by the hash of its key */
+};
+
+/** @struct hgraph_shard
+    @brief A partition of the vertices of an "Hague Graph"
+
+    Each shard has its own map and allocator, so different threads can add vertices to different shards
+    without locking. An edge is counted in the shard of its starting vertex, and so are the occurrences of its
+    k-mer when k-mers are filtered.
+
+    Each shard also classifies its vertices by the difference of their outdegree and indegree, updated whenever
+    a side is added, so the eulerian properties of the graph are known at any time without visiting its
+    vertices. Vertices whose outdegree exceeds their indegree by one are sources and the opposite ones sinks: the
+    XOR of their addresses and keys is kept, which is the address and key of the only one when there is one.
+*/
+struct hgraph_shard
+{
+    htable* vertices; /**< Map of the vertices of the shard, keys are stored in the map only */
+    harena* arena; /**< Allocator of the vertices of the shard */
+    uint64_t count_edges; /**< Number of edges starting from a vertex of the shard */
+    hbloom* filter; /**< Occurrences of the k-mers starting from a vertex of the shard, NULL if not filtered */
+    uint64_t count_balanced_vertices; /**< Number of vertices with as many incoming as outgoing edges */
+    uint64_t count_semi_balanced_vertices; /**< Number of sources and sinks */
+    uint64_t count_generic_vertices; /**< Number of other vertices */
+    uintptr_t sources; /**< XOR of the addresses of the sources */
+    uintptr_t sinks; /**< XOR of the addresses of the sinks */
+    uint64_t* source_keys; /**< XOR of the packed keys of the sources */
+    uint64_t* sink_keys; /**< XOR of the packed keys of the sinks */
+    bool stale; /**< True if degrees have been changed without updating the classification, see hgraph_count_shard */
 };
 
 /** @struct hgraph_vertex
     @brief A struct representing an "Hague Graph" vertex
 
-    An hague vertex has a key field which is also the vertex label(i.e the k-1-mer), two fields are used
-    to store the degree of the vertex and a list of adjacency is used to mantain graph structure.
-    The struct is also hashed to let perform operation using hash operators.
+    An hague vertex is identified by its key(i.e the packed k-1-mer), which is stored in the vertices map of the
+    graph only. Over the {A,C,G,T} alphabet a vertex has at most 4 successors, key + b for each base b, and 4
+    predecessors, b + key, so adjacency is stored inline as a bitmask and a multiplicity counter for each base:
+    the edge to the successor through base b is the k-mer key + b, and its multiplicity is the number of times
+    that k-mer has been added. Successors are also linked directly, so graph traversals never hash a key.
 */
 struct hgraph_vertex
 {
-    char* key; /**< Node identifier */
-    uint64_t indegree; /**< Indegree */
-    uint64_t outdegree; /**< Outdegree */ 
-    uint64_t next_neighbour; /**< Next neighbour index, needed for linear search */
-    struct hgraph_edge** neighbours; /**< Connected edges */
-    UT_hash_handle hh; /**< Make this struct hashable */
+    struct hgraph_vertex* next[4]; /**< Successor reached by each base, NULL if there is no such edge */
+    uint32_t out_multiplicity[4]; /**< Number of edges to the successor reached by each base */
+    uint32_t in_multiplicity[4]; /**< Number of edges from the predecessor starting with each base */
+    uint32_t next_neighbour; /**< Number of outgoing edges already followed in the eulerian walk */
+    uint8_t successors; /**< Bit b is set if and only if the successor through base b exists */
+    uint8_t predecessors; /**< Bit b is set if and only if the predecessor starting with base b exists */
+    uint8_t flipped; /**< Bit b is set if the successor through base b is stored as its reverse complement */
+};
+
+/** @struct hgraph_build_options
+    @brief Parameters of the construction of a De Bruijn graph from a FASTA file
+*/
+struct hgraph_build_options
+{
+    uint64_t k; /**< Length of the k-mers */
+    uint64_t threads; /**< Number of threads adding k-mers to the graph, the reader thread excluded */
+    pipeline_stats* stats; /**< Set to the stalls of the reader pipeline if not NULL */
+    uint64_t min_count; /**< Number of occurrences of a k-mer before its edge is added, 1 to add every k-mer */
+    uint64_t filter_counters; /**< Number of counters of the k-mer filter, 0 to size it from the input */
+    bool canonical; /**< True to fold k-mers with their reverse complements, see hgraph */
+    bool sort; /**< True to count k-mers by sorting them with hsort instead of inserting each occurrence */
+    uint64_t max_memory; /**< Number of bytes of sorted k-mers held in memory, 0 to hold them all, see hsort */
+    uint64_t input_length; /**< Estimated number of characters of the input, 0 if unknown */
+    output* stream; /**< Output the sorted edges are written to instead of being added, NULL to add them */
+    bool weighted; /**< True to write each streamed edge once with its multiplicity */
 };
 
-/** @struct hgraph_edge
-    @brief A struct representing an "Hague Graph" edge
+/** @struct hgraph_export_part
+    @brief A part of the edges of an "Hague Graph" written to its own file by its own thread
+*/
+struct hgraph_export_part
+{
+    hgraph* g; /**< Graph being exported */
+    char* filename; /**< Name of the file of the part */
+    bool weighted; /**< True to write each distinct edge once with its multiplicity */
+    uint64_t part; /**< Index of the part */
+    uint64_t count_parts; /**< Number of parts */
+    pthread_t thread; /**< Thread writing the part, unused for part 0 which is written by the calling thread */
+};
+
+/** @struct hgraph_walk_sink
+    @brief Destination of an eulerian walk, given in chunks while the walk is being computed
+
+    Hierholzer's algorithm finds the edges of a walk from the last one to the first one, so the chunks are given
+    from the end of the walk to its beginning, each one together with its offset in the walk.
+*/
+struct hgraph_walk_sink
+{
+    void (*write)(hgraph_walk_sink*, const char*, uint64_t, uint64_t); /**< Store a chunk, its length and offset */
+    void* context; /**< Destination used by write, e.g. a string or an hgraph_walk_file */
+};
+
+/** @struct hgraph_walk_file
+    @brief A seekable file an eulerian walk is written to by a sink
+*/
+struct hgraph_walk_file
+{
+    int fd; /**< Descriptor of the file */
+    uint64_t offset; /**< Offset of the beginning of the walk in the file */
+};
+
+/** @struct hgraph_walker
+    @brief A graph an eulerian walk is computed on, seen through accessors of its steps
 
-    An hague edge has a label field(i.e the k-mer) and a next field which is the label of
-    the the ending vertex of the directed edge
+    A step is a vertex together with the edge used to reach it, packed in a word by the graph, e.g. a vertex
+    pointer or index with the last base of the edge in its low bits. Hague graphs, images and compacted graphs
+    give their steps to the same walk, which only follows successors and copies labels. The successor of a vertex
+    whose edges have all been followed is HGRAPH_WALK_NONE.
 */
-struct hgraph_edge
+struct hgraph_walker
 {
-    char* label; /**< k-mer string */
-    char* next; /**< Next node key */
+    void* graph; /**< Graph given to the accessors, together with the followed edges of its vertices */
+    uint64_t (*successor)(void*, uint64_t); /**< Follow the next edge of the vertex of a step, return the new step */
+    const char* (*label)(void*, uint64_t, uint64_t*); /**< Return the characters appended by a step, and their number */
+    uint64_t start; /**< Step of the starting vertex, which is reached through no edge */
+    const uint64_t* start_key; /**< Packed key of the starting vertex */
+    uint64_t key_length; /**< Number of bases of a vertex key */
+    uint64_t count_steps; /**< Number of edges to follow, each one counted once for each time it is followed */
+    uint64_t length; /**< Number of characters of the walk */
 };
 
 /**
- * @brief Create hague graph
+ * @brief Return the number of outgoing edges of a vertex
+ */
+static inline uint64_t
+hgraph_vertex_outdegree(hgraph_vertex* v)
+{
+    return (uint64_t) v->out_multiplicity[0] + v->out_multiplicity[1] + v->out_multiplicity[2]
+                                             + v->out_multiplicity[3];
+}
+
+/**
+ * @brief Return the number of incoming edges of a vertex
+ */
+static inline uint64_t
+hgraph_vertex_indegree(hgraph_vertex* v)
+{
+    return (uint64_t) v->in_multiplicity[0] + v->in_multiplicity[1] + v->in_multiplicity[2]
+                                            + v->in_multiplicity[3];
+}
+
+/**
+ * @brief Return true if and only if a vertex has an edge to the successor through a given base
+ */
+static inline bool
+hgraph_vertex_has_successor(hgraph_vertex* v, uint8_t base)
+{
+    return (v->successors >> base) & 1;
+}
+
+/**
+ * @brief Link the successor of a vertex through a given base, flagged with HGRAPH_REVERSE if it is stored as its
+ *        reverse complement
+ */
+static inline void
+hgraph_vertex_link(hgraph_vertex* v, uint8_t base, hgraph_vertex* successor, uint8_t flag)
+{
+    v->next[base] = successor;
+    v->flipped = (v->flipped & ~(1 << base)) | ((flag >> 2) << base);
+}
+
+/**
+ * @brief Return the index of the shard of a graph a packed vertex key belongs to
+ *
+ * The shard is taken from the high bits of the hash, the map of the shard uses the low ones
+ */
+static inline uint64_t
+hgraph_shard_index(hgraph* g, const uint64_t* key)
+{
+    if (g->count_shards == 1)
+    {
+        return 0;
+    }
+
+    return ((hkmer_hash(key, g->key_words) >> 32) * g->count_shards) >> 32;
+}
+
+/**
+ * @brief Count an occurrence of the k-mer given by its starting key and last base in the filter of its shard
+ *
+ * @return The multiplicity to add to the edge of the k-mer, 0 until it has occurred min_count times
+ */
+static inline uint32_t
+hgraph_shard_filter_kmer(hgraph* g, hgraph_shard* shard, const uint64_t* start, uint8_t last)
+{
+    if (shard->filter == NULL)
+    {
+        return 1;
+    }
+
+    uint64_t hash = hkmer_hash(start, g->key_words) ^ ((last + 1) * 0x9E3779B97F4A7C15ULL);
+    uint8_t estimate = hbloom_add(shard->filter, hash);
+    if (estimate < g->min_count)
+    {
+        return 0;
+    }
+
+    // The occurrences counted before the edge is added are added at once, the estimate may have skipped min_count
+    hgraph_vertex* v = htable_get(shard->vertices, start);
+    if (v == NULL)
+    {
+        return g->min_count;
+    }
+
+    uint32_t multiplicity = last & HGRAPH_REVERSE ? v->in_multiplicity[hkmer_complement_base(last & 3)]
+                                                  : v->out_multiplicity[last];
+
+    return multiplicity == 0 ? g->min_count : 1;
+}
+
+/**
+ * @brief Create hague graph for k-mers of a given length
+ *
+ * @return initialized hague graph
+ */
+hgraph*
+hgraph_create(uint64_t);
+
+/**
+ * @brief Create hague graph for k-mers of a given length whose vertices are partitioned into a number of shards
  *
  * @return initialized hague graph
  */
 hgraph*
-hgraph_create();
+hgraph_create_sharded(uint64_t, uint64_t);
+
+/**
+ * @brief Create hague graph for k-mers of a given length and at most a given number of vertices, whose edges can be
+ *        added by several threads at the same time with hgraph_add_edge_concurrent
+ *
+ * @return initialized hague graph
+ */
+hgraph*
+hgraph_create_concurrent(uint64_t, uint64_t);
+
+/**
+ *
+ * @brief Only add the edge of a k-mer once it has occurred a given number of times, counted by filters of a given
+ *        total number of counters
+ */
+void
+hgraph_create_kmer_filters(hgraph*, uint64_t, uint64_t);
+
+/**
+ *
+ * @brief Destroy the k-mer filters of an hague graph, edges are added unconditionally again
+ */
+void
+hgraph_destroy_kmer_filters(hgraph*);
 
 /**
  * @brief Return the number of vertex in an hague graph
@@ -90,21 +343,78 @@ hgraph_edge_count(hgraph*);
  * @brief Return an hague vertex from a given hague graph
  */
 hgraph_vertex*
-hgraph_get_vertex(hgraph*, char*);
+hgraph_get_vertex(hgraph*, uint64_t*);
 
 /**
  *
  * @brief Create a vertex in an hague graph
  */
 hgraph_vertex*
-hgraph_add_vertex(hgraph*, char*);
+hgraph_add_vertex(hgraph*, uint64_t*);
+
+/**
+ *
+ * @brief Create an edge in an hague graph, return its starting vertex
+ */
+hgraph_vertex*
+hgraph_add_edge(hgraph*, uint64_t*, uint64_t*);
 
 /**
  *
- * @brief Create an edge in an hague graph
+ * @brief Thread-safe version of hgraph_add_edge for graphs created by hgraph_create_concurrent
  */
-hgraph_edge*
-hgraph_add_edge(hgraph*, char*, char*);
+hgraph_vertex*
+hgraph_add_edge_concurrent(hgraph*, uint64_t*, uint64_t*);
+
+/**
+ *
+ * @brief Create a vertex in a shard of an hague graph, the key must belong to the shard
+ */
+hgraph_vertex*
+hgraph_shard_add_vertex(hgraph_shard*, uint64_t*);
+
+/**
+ *
+ * @brief Add the outgoing side of an edge to a shard a given number of times, given its starting key and last base
+ */
+hgraph_vertex*
+hgraph_shard_add_edge_start(hgraph_shard*, uint64_t*, uint8_t, uint32_t);
+
+/**
+ *
+ * @brief Add the incoming side of an edge to a shard a given number of times, given its ending key and first base
+ */
+hgraph_vertex*
+hgraph_shard_add_edge_end(hgraph_shard*, uint64_t*, uint8_t, uint32_t);
+
+/**
+ *
+ * @brief Select the keys and bases of the two sides of the edge between two vertex keys, folding the edge with
+ *        its reverse complement in a canonical graph
+ */
+void
+hgraph_orient_edge(hgraph*, uint64_t*, uint64_t*, uint64_t*, uint64_t**, uint8_t*, uint64_t**, uint8_t*);
+
+/**
+ *
+ * @brief Select the key and base of the incoming side of an edge given its outgoing side
+ */
+void
+hgraph_edge_end(hgraph*, const uint64_t*, uint8_t, uint64_t*, uint64_t**, uint8_t*);
+
+/**
+ *
+ * @brief Link the vertices of a shard of an hague graph to their successors
+ */
+void
+hgraph_link_shard(hgraph*, uint64_t);
+
+/**
+ *
+ * @brief Classify again the vertices of a shard of an hague graph whose degrees have been set directly
+ */
+void
+hgraph_count_shard(hgraph*, uint64_t);
 
 /**
  *
@@ -157,30 +467,123 @@ hgraph_has_eulerian_properties(hgraph*);
 
 /**
  *
- * @brief Compute the eulerian walk on an hague graph
+ * @brief Give the eulerian walk of a graph seen through a walker to a sink, false if its edges are not connected
+ */
+bool
+hgraph_walk(hgraph_walker*, hgraph_walk_sink*);
+
+/**
+ *
+ * @brief Return the eulerian walk of a graph seen through a walker, NULL if its edges are not connected
+ */
+char*
+hgraph_walk_string(hgraph_walker*);
+
+/**
+ *
+ * @brief Write the eulerian walk of a graph seen through a walker to a file descriptor, false if there is none
+ */
+bool
+hgraph_walk_export(hgraph_walker*, int);
+
+/**
+ *
+ * @brief Compute the eulerian walk on an hague graph, NULL if its edges are not connected
  */
 char*
 hgraph_compute_eulerian_walk(hgraph*);
 
+/**
+ *
+ * @brief Give the eulerian walk of an hague graph to a sink in bounded chunks, false if its edges are not connected
+ */
+bool
+hgraph_write_eulerian_walk(hgraph*, hgraph_walk_sink*);
+
+/**
+ *
+ * @brief Write the eulerian walk of an hague graph to a file descriptor, false if its edges are not connected
+ */
+bool
+hgraph_export_eulerian_walk(hgraph*, int);
+
+/**
+ *
+ * @brief Add the k-mers of a nucleotide sequence to an hague graph
+ */
+void
+hgraph_add_sequence(hgraph*, const char*, uint64_t);
+
+/**
+ *
+ * @brief Add the k-mers of the records of a FASTA text to an hague graph
+ */
+void
+hgraph_add_fasta(hgraph*, const char*, uint64_t);
+
+/**
+ *
+ * @brief Initialize the construction parameters for k-mers of a given length to their default values
+ */
+void
+hgraph_build_options_init(hgraph_build_options*, uint64_t);
+
 /**
  *
  * @brief Create De Bruijn graph from a FASTA sequence
  */
 hgraph*
-hgraph_create_de_bruijn_graph(kseq_t*, uint64_t);
+hgraph_create_de_bruijn_graph(kseq_t*, hgraph_build_options*);
+
+/**
+ *
+ * @brief Create De Bruijn graph from a FASTA file, parsed in place if it is not compressed
+ */
+hgraph*
+hgraph_create_de_bruijn_graph_from_file(char*, hgraph_build_options*);
+
+/**
+ *
+ * @brief Save graph to file using Gephi "Edges table" notation, with a weight column if edges are counted
+ */
+void
+hgraph_export_to_file(hgraph*, char*, bool);
+
+/**
+ *
+ * @brief Write the header of the Gephi "Edges table" of an hague graph, with a weight column if edges are counted
+ */
+void
+hgraph_write_edges_header(hgraph*, output*, bool);
+
+/**
+ *
+ * @brief Write an edge to the Gephi "Edges table" of an hague graph, as it is written once added a number of times
+ */
+void
+hgraph_write_edge(hgraph*, output*, bool, const uint64_t*, uint8_t, const uint64_t*, uint8_t, uint32_t, uint64_t*,
+                  char*);
+
+/**
+ *
+ * @brief Write the outgoing edges of a vertex of the forward strand to a Gephi "Edges table", given its key and
+ * the multiplicities of its edges
+ */
+void
+hgraph_write_vertex_edges(output*, bool, const uint64_t*, uint64_t, const uint32_t*, char*);
 
 /**
  *
- * @brief Save graph to file using Gephi "Edges table" notation
+ * @brief Save graph to a given number of files written in parallel, using Gephi "Edges table" notation
  */
 void
-hgraph_export_to_file(hgraph*, char*);
+hgraph_export_to_files(hgraph*, char*, bool, uint64_t);
 
 /**
  *
- * @brief Print graph to console using Gephi "Edges table" notation
+ * @brief Print graph to console using Gephi "Edges table" notation, with a weight column if edges are counted
  */
 void
-hgraph_print_graph(hgraph*);
+hgraph_print_graph(hgraph*, bool);
 
 #endif
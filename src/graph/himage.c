@@ -0,0 +1,467 @@
+#include "himage.h"
+
+/**
+ *  Return offset rounded up to the alignment of the sections of an image
+ */
+static inline uint64_t
+align_section(uint64_t offset)
+{
+    return (offset + HIMAGE_ALIGNMENT - 1) & ~(uint64_t) (HIMAGE_ALIGNMENT - 1);
+}
+
+/**
+ *  Return the number of outgoing edges of vertex v of an image
+ */
+static inline uint64_t
+outdegree(const himage_vertex* v)
+{
+    return (uint64_t) v->out_multiplicity[0] + v->out_multiplicity[1] + v->out_multiplicity[2]
+                                             + v->out_multiplicity[3];
+}
+
+/**
+ *  Return the number of incoming edges of vertex v of an image
+ */
+static inline uint64_t
+indegree(const himage_vertex* v)
+{
+    return (uint64_t) v->in_multiplicity[0] + v->in_multiplicity[1] + v->in_multiplicity[2]
+                                            + v->in_multiplicity[3];
+}
+
+/**
+ *  Fill the header h of the image of graph g, laying out its sections
+ */
+static void
+fill_header(hgraph* g, himage_header* h)
+{
+    memset(h, 0, sizeof(himage_header));
+    memcpy(h->magic, HIMAGE_MAGIC, sizeof(HIMAGE_MAGIC));
+    h->version = HIMAGE_VERSION;
+    h->vertex_size = sizeof(himage_vertex);
+    h->k = g->k;
+    h->count_vertices = hgraph_vertex_count(g);
+    h->count_edges = hgraph_edge_count(g);
+
+    // Same maximum load factor as htable
+    h->capacity = 16;
+    while (h->count_vertices * 10 > h->capacity * 7)
+    {
+        h->capacity *= 2;
+    }
+
+    h->index_offset = align_section(sizeof(himage_header));
+    h->keys_offset = align_section(h->index_offset + h->capacity * sizeof(uint64_t));
+    h->vertices_offset = align_section(h->keys_offset + h->count_vertices * g->key_words * sizeof(uint64_t));
+    h->length = h->vertices_offset + h->count_vertices * sizeof(himage_vertex);
+}
+
+/**
+ *  Set the fields of img to the image of length bytes mapped at data
+ */
+static void
+attach_image(himage* img, const uint8_t* data, uint64_t length)
+{
+    const himage_header* h = (const himage_header*) data;
+
+    img->data = data;
+    img->length = length;
+    img->k = h->k;
+    img->key_words = hkmer_words(h->k - 1);
+    img->count_vertices = h->count_vertices;
+    img->count_edges = h->count_edges;
+    img->capacity = h->capacity;
+    img->index = (const uint64_t*) &data[h->index_offset];
+    img->keys = (const uint64_t*) &data[h->keys_offset];
+    img->vertices = (const himage_vertex*) &data[h->vertices_offset];
+}
+
+/**
+ *  Return the index of the slot of the hash index of img holding key, or of the empty slot where key belongs
+ */
+static inline uint64_t
+find_slot(himage* img, const uint64_t* key)
+{
+    uint64_t mask = img->capacity - 1;
+    uint64_t i = hkmer_hash(key, img->key_words) & mask;
+
+    while (img->index[i] != 0 && !hkmer_equal(&img->keys[(img->index[i] - 1) * img->key_words], key,
+                                              img->key_words))
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**
+ * @param g An initialized hague graph of the forward strand
+ * @param filename Name of the output file
+ *
+ * The image is written in place through a shared mapping of the output file. Vertices are numbered in the order
+ * of the shards of g and of their slots, which is also the order of hgraph_export_to_file
+ */
+void
+himage_save(hgraph* g, const char* filename)
+{
+    assert(g != NULL && "Graph is not initialized");
+    assert(!g->canonical && "Graph images need a graph of the forward strand");
+
+    himage_header h;
+    fill_header(g, &h);
+
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0 && "Could not open graph image");
+    int error = ftruncate(fd, h.length);
+    assert(error == 0 && "Could not write graph image");
+
+    uint8_t* data = mmap(NULL, h.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    assert(data != MAP_FAILED && "Could not write graph image");
+    memcpy(data, &h, sizeof(himage_header));
+
+    himage img;
+    attach_image(&img, data, h.length);
+
+    // The file is zero filled by ftruncate, so every slot of the index starts empty
+    uint64_t* index = (uint64_t*) img.index;
+    uint64_t* keys = (uint64_t*) img.keys;
+    himage_vertex* vertices = (himage_vertex*) img.vertices;
+    uint64_t key_size = g->key_words * sizeof(uint64_t);
+
+    uint64_t count = 0;
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* table = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < table->capacity; i++)
+        {
+            if (table->values[i] != NULL)
+            {
+                memcpy(&keys[count * g->key_words], htable_key_at(table, i), key_size);
+                index[find_slot(&img, &keys[count * g->key_words])] = count + 1;
+                count++;
+            }
+        }
+    }
+
+    // Successors are numbered once every key is indexed
+    uint64_t* successor = malloc(key_size);
+    count = 0;
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* table = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < table->capacity; i++)
+        {
+            hgraph_vertex* v = table->values[i];
+            if (v == NULL)
+            {
+                continue;
+            }
+
+            himage_vertex* w = &vertices[count];
+            memcpy(w->out_multiplicity, v->out_multiplicity, sizeof(w->out_multiplicity));
+            memcpy(w->in_multiplicity, v->in_multiplicity, sizeof(w->in_multiplicity));
+            w->successors = v->successors;
+            w->predecessors = v->predecessors;
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                w->next[base] = HIMAGE_NONE;
+                if (hgraph_vertex_has_successor(v, base))
+                {
+                    memcpy(successor, &keys[count * g->key_words], key_size);
+                    hkmer_push_back(successor, g->k - 1, base);
+                    w->next[base] = himage_get_vertex(&img, successor);
+                }
+            }
+            count++;
+        }
+    }
+
+    free(successor);
+    munmap(data, h.length);
+    close(fd);
+}
+
+/**
+ * @param filename Name of a file written by himage_save
+ * @return The mapped image, whose pages are only read when they are used
+ */
+himage*
+himage_open(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    assert(fd >= 0 && "Could not open graph image");
+
+    struct stat st;
+    int error = fstat(fd, &st);
+    assert(error == 0 && (uint64_t) st.st_size >= sizeof(himage_header) && "Not a graph image");
+
+    const uint8_t* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    assert(data != MAP_FAILED && "Could not map graph image");
+
+    const himage_header* h = (const himage_header*) data;
+    assert(memcmp(h->magic, HIMAGE_MAGIC, sizeof(HIMAGE_MAGIC)) == 0 && "Not a graph image");
+    assert(h->version == HIMAGE_VERSION && h->vertex_size == sizeof(himage_vertex) &&
+                   "Unsupported graph image version");
+    assert(h->length == (uint64_t) st.st_size && h->k > 1 && "Truncated graph image");
+
+    himage* img = malloc(sizeof(himage));
+    img->fd = fd;
+    attach_image(img, data, st.st_size);
+
+    return img;
+}
+
+/**
+ * @param img A mapped image
+ */
+void
+himage_close(himage* img)
+{
+    assert(img != NULL && "Graph image is not opened");
+
+    munmap((void*) img->data, img->length);
+    close(img->fd);
+    free(img);
+}
+
+/**
+ * @param img A mapped image
+ * @param key A packed (k-1)-mer
+ * @return The index of the vertex of img whose key is key, HIMAGE_NONE if there is none
+ */
+uint64_t
+himage_get_vertex(himage* img, const uint64_t* key)
+{
+    uint64_t slot = img->index[find_slot(img, key)];
+
+    return slot == 0 ? HIMAGE_NONE : slot - 1;
+}
+
+/**
+ *  Return the vertex an eulerian walk of img starts from, HIMAGE_NONE if there is no eulerian path or cycle. As
+ *  in hgraph_compute_eulerian_path_properties, a cycle starts from the first vertex
+ */
+static uint64_t
+walk_start(himage* img)
+{
+    uint64_t start = HIMAGE_NONE;
+    uint64_t count_semi_balanced = 0;
+    uint64_t count_generic = 0;
+
+    for (uint64_t i = 0; i < img->count_vertices; i++)
+    {
+        uint64_t in = indegree(&img->vertices[i]);
+        uint64_t out = outdegree(&img->vertices[i]);
+
+        if (in == out)
+        {
+            continue;
+        }
+
+        if (in == out + 1 || out == in + 1)
+        {
+            count_semi_balanced++;
+            start = out == in + 1 ? i : start;
+        }
+        else
+        {
+            count_generic++;
+        }
+    }
+
+    if (count_generic == 0 && count_semi_balanced == 0)
+    {
+        return img->count_vertices > 0 ? 0 : HIMAGE_NONE;
+    }
+
+    return count_generic == 0 && count_semi_balanced == 2 ? start : HIMAGE_NONE;
+}
+
+/**
+ *  Return the base of the next edge to follow from vertex v of img, whose first followed edges are counted in
+ *  followed, 4 if every edge has been followed
+ */
+static inline uint8_t
+next_walk_base(const himage_vertex* v, uint32_t followed)
+{
+    uint64_t j = followed;
+
+    for (uint8_t base = 0; base < 4; base++)
+    {
+        if (j < v->out_multiplicity[base])
+        {
+            return base;
+        }
+        j -= v->out_multiplicity[base];
+    }
+
+    return 4;
+}
+
+/**
+ *  Successor accessor of the walker of an image. A step is the index of a vertex shifted by 2 bits, together with
+ *  the base of the edge used to reach it in the low bits
+ */
+static uint64_t
+walk_successor(void* graph, uint64_t step)
+{
+    himage_walk* walk = graph;
+    uint64_t i = step >> 2;
+    const himage_vertex* v = &walk->img->vertices[i];
+    uint8_t base = next_walk_base(v, walk->followed[i]);
+
+    if (base == 4)
+    {
+        return HGRAPH_WALK_NONE;
+    }
+
+    walk->followed[i]++;
+
+    return (v->next[base] << 2) | base;
+}
+
+/**
+ *  Label accessor of the walker of an image, an edge appends its last base to the walk
+ */
+static const char*
+walk_label(void* graph, uint64_t step, uint64_t* length)
+{
+    (void) graph;
+    *length = 1;
+
+    return &"ACGT"[step & 3];
+}
+
+/**
+ *  Set w to walk img from the starting vertex of its eulerian walk, counting the followed edges in walk, whose
+ *  array is allocated here. Return false if img has no eulerian path or cycle, in which case nothing is allocated
+ */
+static bool
+init_walker(himage* img, himage_walk* walk, hgraph_walker* w)
+{
+    uint64_t start = walk_start(img);
+    if (start == HIMAGE_NONE)
+    {
+        return false;
+    }
+
+    walk->img = img;
+    walk->followed = calloc(img->count_vertices, sizeof(uint32_t));
+    assert(walk->followed != NULL && "Could not allocate eulerian walk");
+
+    w->graph = walk;
+    w->successor = walk_successor;
+    w->label = walk_label;
+    w->start = start << 2;
+    w->start_key = &img->keys[start * img->key_words];
+    w->key_length = img->k - 1;
+    w->count_steps = img->count_edges;
+    w->length = img->count_edges + w->key_length;
+
+    return true;
+}
+
+/**
+ * @param img A mapped image
+ * @return A string containing the concatenation of edge labels, from eulerian walk starting node to ending node,
+ *         NULL if the edges of img can't be covered by a single walk
+ *
+ * The walk is computed by hgraph_walk, the number of followed edges of each vertex being kept in a private array
+ * since the image is read-only. It spells the same string as the walk of the graph the image has been saved from.
+ */
+char*
+himage_compute_eulerian_walk(himage* img)
+{
+    assert(img != NULL && "Graph image is not opened");
+
+    himage_walk walk;
+    hgraph_walker w;
+    if (!init_walker(img, &walk, &w))
+    {
+        return NULL;
+    }
+
+    char* result = hgraph_walk_string(&w);
+    free(walk.followed);
+
+    return result;
+}
+
+/**
+ * @param img A mapped image
+ * @param fd Descriptor of the output file, the console or a pipe
+ * @return True if the walk has been written, false if the edges of img can't be covered by a single walk
+ *
+ * The walk is computed like himage_compute_eulerian_walk and written like hgraph_export_eulerian_walk, so memory
+ * doesn't depend on its length. Nothing is written if there is no walk
+ */
+bool
+himage_export_eulerian_walk(himage* img, int fd)
+{
+    assert(img != NULL && "Graph image is not opened");
+
+    himage_walk walk;
+    hgraph_walker w;
+    if (!init_walker(img, &walk, &w))
+    {
+        return false;
+    }
+
+    bool connected = hgraph_walk_export(&w, fd);
+    free(walk.followed);
+
+    return connected;
+}
+
+/**
+ *  Write the edges of img to o using Gephi "Edges table" notation, like hgraph_export_to_file
+ */
+static void
+write_edges_table(himage* img, output* o, bool weighted)
+{
+    uint64_t key_length = img->k - 1;
+    char* line = malloc(3 * key_length + 6);
+
+    const char* header = weighted ? "Source, Target, Label, Weight\n" : "Source, Target, Label\n";
+    output_write(o, header, strlen(header));
+
+    for (uint64_t i = 0; i < img->count_vertices; i++)
+    {
+        hgraph_write_vertex_edges(o, weighted, &img->keys[i * img->key_words], key_length,
+                                  img->vertices[i].out_multiplicity, line);
+    }
+
+    free(line);
+}
+
+/**
+ * @param img A mapped image
+ * @param filename Name of the output file
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ */
+void
+himage_export_to_file(himage* img, char* filename, bool weighted)
+{
+    assert(img != NULL && "Graph image is not opened");
+    output* o = output_open(filename);
+    write_edges_table(img, o, weighted);
+
+    output_close(o);
+}
+
+/**
+ * @param img A mapped image
+ * @param weighted True to write each distinct edge once with the number of times it has been added
+ */
+void
+himage_print_graph(himage* img, bool weighted)
+{
+    assert(img != NULL && "Graph image is not opened");
+    output* o = output_open_stdout();
+    write_edges_table(img, o, weighted);
+
+    output_close(o);
+}
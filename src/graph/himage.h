@@ -0,0 +1,165 @@
+#ifndef HAGUE_IMAGE_H
+#define HAGUE_IMAGE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/hgraph.h"
+
+/**
+ * First bytes of a graph image, the terminator included
+ */
+#define HIMAGE_MAGIC "HAGUEIM"
+
+/**
+ * Version of the layout of graph images, incremented on every incompatible change, e.g. of hkmer_hash
+ */
+#define HIMAGE_VERSION 1
+
+/**
+ * Alignment of the sections of an image, so that each one starts on a page
+ */
+#define HIMAGE_ALIGNMENT 4096
+
+/**
+ * Index of a missing vertex
+ */
+#define HIMAGE_NONE UINT64_MAX
+
+typedef struct himage himage;
+
+typedef struct himage_header himage_header;
+
+typedef struct himage_vertex himage_vertex;
+
+typedef struct himage_walk himage_walk;
+
+/** @struct himage_header
+    @brief Beginning of a graph image, giving the offset of each of its sections from the beginning of the file
+*/
+struct himage_header
+{
+    char magic[8]; /**< HIMAGE_MAGIC */
+    uint32_t version; /**< HIMAGE_VERSION */
+    uint32_t vertex_size; /**< Size of an himage_vertex, to reject images of another architecture */
+    uint64_t k; /**< Length of the k-mers */
+    uint64_t count_vertices; /**< Number of vertices */
+    uint64_t count_edges; /**< Number of edges, counted once for each time they have been added */
+    uint64_t capacity; /**< Number of slots of the hash index, a power of 2 */
+    uint64_t index_offset; /**< Offset of the hash index, capacity words */
+    uint64_t keys_offset; /**< Offset of the packed keys, key_words words for each vertex */
+    uint64_t vertices_offset; /**< Offset of the vertices */
+    uint64_t length; /**< Number of bytes of the image */
+};
+
+/** @struct himage_vertex
+    @brief A vertex of a graph image, whose successors are given by their index instead of a pointer
+*/
+struct himage_vertex
+{
+    uint64_t next[4]; /**< Index of the successor reached by each base, HIMAGE_NONE if there is no such edge */
+    uint32_t out_multiplicity[4]; /**< Number of edges to the successor reached by each base */
+    uint32_t in_multiplicity[4]; /**< Number of edges from the predecessor starting with each base */
+    uint8_t successors; /**< Bit b is set if and only if the successor through base b exists */
+    uint8_t predecessors; /**< Bit b is set if and only if the predecessor starting with base b exists */
+};
+
+/** @struct himage
+    @brief A read-only "Hague Graph" used in place from a file mapped in memory
+
+    An image holds no pointer, so it can be mapped at any address: vertices are numbered, successors are given
+    by their number and keys are found through a hash index of open-addressing slots holding the number of a
+    vertex plus 1, 0 for empty slots, probed linearly from hkmer_hash of the key. Opening an image maps it
+    without reading it, and concurrent processes mapping the same image share its pages in the page cache.
+*/
+struct himage
+{
+    int fd; /**< Descriptor of the file */
+    const uint8_t* data; /**< Mapped content of the file */
+    uint64_t length; /**< Number of bytes of the file */
+    uint64_t k; /**< Length of the k-mers, vertex keys are (k-1)-mers */
+    uint64_t key_words; /**< Number of words of a packed vertex key */
+    uint64_t count_vertices; /**< Number of vertices */
+    uint64_t count_edges; /**< Number of edges */
+    uint64_t capacity; /**< Number of slots of the hash index */
+    const uint64_t* index; /**< Slots of the hash index */
+    const uint64_t* keys; /**< Packed keys of the vertices */
+    const himage_vertex* vertices; /**< Vertices */
+};
+
+/** @struct himage_walk
+    @brief Graph given to the accessors of the walker of an image, which is read-only so that the number of
+    followed edges of each vertex is kept aside
+*/
+struct himage_walk
+{
+    const himage* img; /**< Image being walked */
+    uint32_t* followed; /**< Number of followed edges of each vertex */
+};
+
+/**
+ *
+ * @brief Write an hague graph of the forward strand to a file as an image
+ */
+void
+himage_save(hgraph*, const char*);
+
+/**
+ *
+ * @brief Map an image written by himage_save, without reading it
+ */
+himage*
+himage_open(const char*);
+
+/**
+ *
+ * @brief Unmap and close an image
+ */
+void
+himage_close(himage*);
+
+/**
+ *
+ * @brief Return the index of the vertex of an image with a given packed key, HIMAGE_NONE if there is none
+ */
+uint64_t
+himage_get_vertex(himage*, const uint64_t*);
+
+/**
+ *
+ * @brief Return the concatenation of the labels of an eulerian walk of an image, NULL if there is none
+ */
+char*
+himage_compute_eulerian_walk(himage*);
+
+/**
+ *
+ * @brief Write an eulerian walk of an image to a file descriptor while it is computed, false if there is none
+ */
+bool
+himage_export_eulerian_walk(himage*, int);
+
+/**
+ *
+ * @brief Export the edges of an image to a file, with their multiplicities as weights if requested
+ */
+void
+himage_export_to_file(himage*, char*, bool);
+
+/**
+ *
+ * @brief Print the edges of an image, with their multiplicities as weights if requested
+ */
+void
+himage_print_graph(himage*, bool);
+
+#endif
@@ -0,0 +1,90 @@
+#include "hkmer.h"
+
+const uint8_t hkmer_encoding_table[256] =
+{
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+/**
+ * @param s An ASCII string of at least length characters
+ * @param length The length of the k-mer
+ * @param kmer Output buffer of hkmer_words(length) words
+ * @return True if s only contains nucleotides (either case), false otherwise
+ */
+bool
+hkmer_encode(const char* s, uint64_t length, uint64_t* kmer)
+{
+    memset(kmer, 0, hkmer_words(length) * sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < length; i++)
+    {
+        uint8_t base = hkmer_encode_base(s[i]);
+        if (base == HKMER_INVALID_BASE)
+        {
+            return false;
+        }
+
+        hkmer_push_back(kmer, length, base);
+    }
+
+    return true;
+}
+
+/**
+ * @param kmer A packed k-mer
+ * @param length The length of the k-mer
+ * @param s Output buffer of at least length + 1 characters
+ */
+void
+hkmer_decode(const uint64_t* kmer, uint64_t length, char* s)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        s[i] = hkmer_decode_base(hkmer_base_at(kmer, length, i));
+    }
+
+    s[length] = '\0';
+}
+
+/**
+ * @param it An uninitialized k-mer iterator
+ * @param length The length of the k-mers
+ */
+void
+hkmer_iter_init(hkmer_iter* it, uint64_t length)
+{
+    assert(length > 1 && "k-mer length must be greater than 1");
+
+    it->length = length - 1;
+    it->words = hkmer_words(it->length);
+    it->valid = 0;
+    it->line_start = true;
+    it->header = false;
+    it->prefix = calloc(it->words, sizeof(uint64_t));
+    it->suffix = calloc(it->words, sizeof(uint64_t));
+}
+
+/**
+ * @param it An initialized k-mer iterator
+ */
+void
+hkmer_iter_destroy(hkmer_iter* it)
+{
+    free(it->prefix);
+    free(it->suffix);
+}
@@ -0,0 +1,323 @@
+#ifndef HAGUE_KMER_H
+#define HAGUE_KMER_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Number of nucleotides packed in a single 64-bit word (2 bits per base)
+ */
+#define HKMER_BASES_PER_WORD 32
+
+/**
+ * Value returned by hkmer_encode_base for characters outside {A,C,G,T,a,c,g,t}
+ */
+#define HKMER_INVALID_BASE 4
+
+/**
+ * Lookup table from ASCII characters to 2-bit nucleotide codes
+ */
+extern const uint8_t hkmer_encoding_table[256];
+
+/*
+ * A packed k-mer is a 2*k bits number stored in hkmer_words(k) 64-bit words, most significant word first.
+ * The first base of the k-mer is the most significant one, so comparing two packed k-mers word by word
+ * gives the same ordering as comparing their ASCII strings. Unused high bits of the first word are always 0.
+ */
+
+/**
+ * @brief Return the number of 64-bit words needed to store a packed k-mer of given length
+ */
+static inline uint64_t
+hkmer_words(uint64_t length)
+{
+    return (length + HKMER_BASES_PER_WORD - 1) / HKMER_BASES_PER_WORD;
+}
+
+/**
+ * @brief Return the mask of the bits used in the first word of a packed k-mer of given length
+ */
+static inline uint64_t
+hkmer_first_word_mask(uint64_t length)
+{
+    uint64_t bases = length - (hkmer_words(length) - 1) * HKMER_BASES_PER_WORD;
+
+    return bases == HKMER_BASES_PER_WORD ? UINT64_MAX : (((uint64_t) 1 << (2 * bases)) - 1);
+}
+
+/**
+ * @brief Return the 2-bit code of a nucleotide, HKMER_INVALID_BASE if c is not a nucleotide
+ */
+static inline uint8_t
+hkmer_encode_base(char c)
+{
+    return hkmer_encoding_table[(uint8_t) c];
+}
+
+/**
+ * @brief Return the (uppercase) nucleotide of a 2-bit code
+ */
+static inline char
+hkmer_decode_base(uint8_t base)
+{
+    return "ACGT"[base & 3];
+}
+
+/**
+ * @brief Return the i-th base of a packed k-mer of given length
+ */
+static inline uint8_t
+hkmer_base_at(const uint64_t* kmer, uint64_t length, uint64_t i)
+{
+    uint64_t position = length - 1 - i;
+    uint64_t word = hkmer_words(length) - 1 - position / HKMER_BASES_PER_WORD;
+
+    return (kmer[word] >> (2 * (position % HKMER_BASES_PER_WORD))) & 3;
+}
+
+/**
+ * @brief Append a base to a packed k-mer of given length, dropping its first base
+ */
+static inline void
+hkmer_push_back(uint64_t* kmer, uint64_t length, uint8_t base)
+{
+    uint64_t words = hkmer_words(length);
+
+    for (uint64_t i = 0; i + 1 < words; i++)
+    {
+        kmer[i] = (kmer[i] << 2) | (kmer[i + 1] >> 62);
+    }
+    kmer[words - 1] = (kmer[words - 1] << 2) | base;
+    kmer[0] &= hkmer_first_word_mask(length);
+}
+
+/**
+ * @brief Return true if and only if two packed k-mers of given number of words are equal
+ */
+static inline bool
+hkmer_equal(const uint64_t* a, const uint64_t* b, uint64_t words)
+{
+    for (uint64_t i = 0; i < words; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Compare two packed k-mers of given number of words, return a negative number, 0 or a positive number if the
+ *        first one is respectively smaller, equal or greater than the second one in lexicographic order
+ */
+static inline int
+hkmer_compare(const uint64_t* a, const uint64_t* b, uint64_t words)
+{
+    for (uint64_t i = 0; i < words; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Return the 2-bit code of the complement of a base
+ */
+static inline uint8_t
+hkmer_complement_base(uint8_t base)
+{
+    return base ^ 3;
+}
+
+/**
+ * @brief Reverse the order of the 32 bases of a word
+ */
+static inline uint64_t
+hkmer_reverse_word(uint64_t w)
+{
+    w = __builtin_bswap64(w);
+    w = ((w >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((w & 0x0F0F0F0F0F0F0F0FULL) << 4);
+
+    return ((w >> 2) & 0x3333333333333333ULL) | ((w & 0x3333333333333333ULL) << 2);
+}
+
+/**
+ * @brief Write the reverse complement of a packed k-mer of given length to another buffer
+ *
+ * Complementing a base flips its two bits, so a word is complemented and reversed with a few mask and shift
+ * operations, whatever its bases
+ */
+static inline void
+hkmer_reverse_complement(const uint64_t* kmer, uint64_t length, uint64_t* rc)
+{
+    uint64_t words = hkmer_words(length);
+
+    for (uint64_t i = 0; i < words; i++)
+    {
+        rc[i] = hkmer_reverse_word(~kmer[words - 1 - i]);
+    }
+
+    // The unused high bits of the first word are now the low bits of the last one, shift them out
+    uint64_t shift = 2 * (words * HKMER_BASES_PER_WORD - length);
+    for (uint64_t i = words - 1; i > 0; i--)
+    {
+        rc[i] = (rc[i] >> shift) | ((rc[i - 1] << 1) << (63 - shift));
+    }
+    rc[0] = (rc[0] >> shift) & hkmer_first_word_mask(length);
+}
+
+/**
+ * @brief Hash a packed k-mer of given number of words
+ */
+static inline uint64_t
+hkmer_hash(const uint64_t* kmer, uint64_t words)
+{
+    uint64_t h = words * 0x9E3779B97F4A7C15ULL;
+
+    for (uint64_t i = 0; i < words; i++)
+    {
+        h ^= kmer[i];
+        h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 31;
+    }
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 32;
+
+    return h;
+}
+
+typedef struct hkmer_iter hkmer_iter;
+
+/** @struct hkmer_iter
+    @brief Rolling extraction of the consecutive k-mers of a sequence
+
+    The iterator is fed one character at a time and keeps the prefix and the suffix (k-1)-mers of the last
+    k-mer read, which are the starting and the ending vertex keys of the corresponding De Bruijn graph edge.
+    Each step shifts one base into both keys, so no k-mer is ever copied or allocated.
+
+    The iterator can also be fed raw FASTA text with hkmer_iter_next_text, which skips header lines and
+    whitespace on the fly.
+*/
+struct hkmer_iter
+{
+    uint64_t length; /**< Length of prefix and suffix, i.e. k - 1 */
+    uint64_t words; /**< Number of words of prefix and suffix */
+    uint64_t valid; /**< Number of nucleotides read since the last reset or invalid character */
+    uint64_t* prefix; /**< Packed first k-1 bases of the last k-mer */
+    uint64_t* suffix; /**< Packed last k-1 bases of the last k-mer */
+    bool line_start; /**< True if the next character of FASTA text starts a line */
+    bool header; /**< True while reading a header line of FASTA text */
+};
+
+/**
+ * @brief Initialize a k-mer iterator for k-mers of given length
+ */
+void
+hkmer_iter_init(hkmer_iter*, uint64_t);
+
+/**
+ * @brief Free the buffers of a k-mer iterator
+ */
+void
+hkmer_iter_destroy(hkmer_iter*);
+
+/**
+ * @brief Restart a k-mer iterator, e.g. at the beginning of a new sequence
+ */
+static inline void
+hkmer_iter_reset(hkmer_iter* it)
+{
+    it->valid = 0;
+    it->line_start = true;
+    it->header = false;
+}
+
+/**
+ * @brief Restart a k-mer iterator inside FASTA text, at the beginning of a line or not, inside a header line or not
+ */
+static inline void
+hkmer_iter_resume_text(hkmer_iter* it, bool line_start, bool header)
+{
+    it->valid = 0;
+    it->line_start = line_start;
+    it->header = header;
+}
+
+/**
+ * @brief Feed a character to a k-mer iterator, return true if a whole k-mer has been read
+ *
+ * A character that is not a nucleotide restarts the iterator, so k-mers spanning it are never returned
+ */
+static inline bool
+hkmer_iter_next(hkmer_iter* it, char c)
+{
+    uint8_t base = hkmer_encode_base(c);
+    if (base == HKMER_INVALID_BASE)
+    {
+        it->valid = 0;
+        return false;
+    }
+
+    // The prefix lags one base behind the suffix
+    hkmer_push_back(it->prefix, it->length, it->suffix[it->words - 1] & 3);
+    hkmer_push_back(it->suffix, it->length, base);
+    it->valid++;
+
+    return it->valid > it->length;
+}
+
+/**
+ * @brief Feed a character of FASTA text to a k-mer iterator, return true if a whole k-mer has been read
+ *
+ * A header line restarts the iterator, whitespace and line breaks inside a sequence are skipped. The first
+ * character must be at the beginning of a line, unless the iterator is resumed with hkmer_iter_resume_text
+ */
+static inline bool
+hkmer_iter_next_text(hkmer_iter* it, char c)
+{
+    bool line_start = it->line_start;
+    it->line_start = c == '\n';
+
+    if (it->header)
+    {
+        it->header = !it->line_start;
+        return false;
+    }
+
+    if (line_start && c == '>')
+    {
+        it->header = true;
+        it->valid = 0;
+        return false;
+    }
+
+    if (c == '\n' || c == '\r' || c == ' ' || c == '\t')
+    {
+        return false;
+    }
+
+    return hkmer_iter_next(it, c);
+}
+
+/**
+ * @brief Pack an ASCII k-mer, return false if it contains characters other than nucleotides
+ */
+bool
+hkmer_encode(const char*, uint64_t, uint64_t*);
+
+/**
+ * @brief Unpack a k-mer into a null terminated ASCII string
+ */
+void
+hkmer_decode(const uint64_t*, uint64_t, char*);
+
+#endif
@@ -0,0 +1,1076 @@
+#include "hsort.h"
+
+/**
+ *  Run fn on every worker of s, worker 0 on the calling thread, and wait for all of them
+ */
+static void
+run_workers(hsort* s, void* (*fn)(void*))
+{
+    for (uint64_t i = 1; i < s->count_workers; i++)
+    {
+        int error = pthread_create(&s->workers[i].thread, NULL, fn, &s->workers[i]);
+        assert(error == 0 && "Could not create sort thread");
+    }
+
+    fn(&s->workers[0]);
+
+    for (uint64_t i = 1; i < s->count_workers; i++)
+    {
+        pthread_join(s->workers[i].thread, NULL);
+    }
+}
+
+/**
+ *  Split count k-mers between the workers of s into ranges of about the same length
+ */
+static void
+split_ranges(hsort* s, uint64_t count)
+{
+    uint64_t range = (count + s->count_workers - 1) / s->count_workers;
+
+    for (uint64_t i = 0; i < s->count_workers; i++)
+    {
+        hsort_worker* w = &s->workers[i];
+        w->begin = i * range < count ? i * range : count;
+        w->end = w->begin + range < count ? w->begin + range : count;
+    }
+}
+
+/**
+ *  Copy a packed k-mer of given number of words
+ */
+static inline void
+copy_kmer(uint64_t* destination, const uint64_t* source, uint64_t words)
+{
+    if (words == 1)
+    {
+        *destination = *source;
+        return;
+    }
+
+    memcpy(destination, source, words * sizeof(uint64_t));
+}
+
+/**
+ *  Pack the last k-mer read by it into kmer with the scratch buffer of worker w. In a canonical graph the smallest
+ *  of the k-mer and its reverse complement is packed, so both strands of an edge are counted together
+ */
+static inline void
+pack_kmer(hsort_worker* w, hkmer_iter* it, uint64_t* kmer)
+{
+    hsort* s = w->sorter;
+    uint64_t words = s->kmer_words;
+
+    // The k-mer is its prefix followed by the last base of its suffix
+    kmer[0] = 0;
+    memcpy(&kmer[words - it->words], it->prefix, it->words * sizeof(uint64_t));
+    hkmer_push_back(kmer, s->g->k, it->suffix[it->words - 1] & 3);
+
+    if (s->g->canonical)
+    {
+        hkmer_reverse_complement(kmer, s->g->k, w->keys);
+        if (hkmer_compare(w->keys, kmer, words) < 0)
+        {
+            copy_kmer(kmer, w->keys, words);
+        }
+    }
+}
+
+/**
+ *  Return the partition of a packed k-mer of s, split level times. Partitions are first given by the high half of
+ *  the hash of the k-mer, then split HSORT_SPLIT_BITS bits at a time from the low half
+ */
+static inline uint64_t
+kmer_partition(hsort* s, const uint64_t* kmer, uint64_t level)
+{
+    uint64_t hash = hkmer_hash(kmer, s->kmer_words);
+    if (level == 0)
+    {
+        return ((hash >> 32) * s->count_partitions) >> 32;
+    }
+
+    return (hash >> (HSORT_SPLIT_BITS * (level - 1))) & (HSORT_SPLIT - 1);
+}
+
+/**
+ *  Append count packed k-mers of s to the file of descriptor fd
+ */
+static void
+append_kmers(hsort* s, int fd, const uint64_t* kmers, uint64_t count)
+{
+    const char* data = (const char*) kmers;
+    uint64_t size = count * s->kmer_words * sizeof(uint64_t);
+
+    while (size > 0)
+    {
+        ssize_t written = write(fd, data, size);
+        assert(written > 0 && "Could not write partition file");
+        data += written;
+        size -= written;
+    }
+}
+
+/**
+ *  Read size bytes of packed k-mers from the given offset of the file of descriptor fd
+ */
+static void
+read_kmers(int fd, uint64_t* kmers, uint64_t size, uint64_t offset)
+{
+    char* data = (char*) kmers;
+
+    while (size > 0)
+    {
+        ssize_t count = pread(fd, data, size, offset);
+        assert(count > 0 && "Could not read partition file");
+        data += count;
+        size -= count;
+        offset += count;
+    }
+}
+
+/**
+ *  Return the descriptor of a new temporary file in TMPDIR, or /tmp, opened for reading and appending. The file
+ *  is unlinked at once, so it is deleted when closed, even if hague exits early
+ */
+static int
+open_partition()
+{
+    const char* directory = getenv("TMPDIR");
+    if (directory == NULL || *directory == '\0')
+    {
+        directory = "/tmp";
+    }
+
+    uint64_t length = strlen(directory) + 20;
+    char* name = malloc(length);
+    assert(name != NULL && "Could not allocate partition file name");
+    snprintf(name, length, "%s/hague-XXXXXX", directory);
+
+    int fd = mkstemp(name);
+    assert(fd >= 0 && "Could not create partition file");
+    unlink(name);
+    free(name);
+
+    // Workers append whole buffers to the same file, so each write must go to its end
+    int error = fcntl(fd, F_SETFL, O_APPEND);
+    assert(error == 0 && "Could not create partition file");
+
+    return fd;
+}
+
+/**
+ *  Append the spill buffer of partition p of worker w to the file of the partition and empty it
+ */
+static void
+flush_spill(hsort_worker* w, uint64_t p)
+{
+    hsort* s = w->sorter;
+
+    append_kmers(s, s->partitions[p], &w->spill[p * s->spill_length * s->kmer_words], w->spill_counts[p]);
+    w->spill_counts[p] = 0;
+}
+
+/**
+ *  Add the last k-mer read by it to worker w: to its array, which has room for it, or to the spill buffer of the
+ *  partition of the k-mer if k-mers are spilled
+ */
+static inline void
+push_kmer(hsort_worker* w, hkmer_iter* it)
+{
+    hsort* s = w->sorter;
+    uint64_t words = s->kmer_words;
+
+    if (s->count_partitions == 0)
+    {
+        pack_kmer(w, it, &w->kmers[w->count_kmers++ * words]);
+        return;
+    }
+
+    // The scratch buffer holds a k-mer and 3 keys, so the k-mer is packed after its reverse complement
+    uint64_t* kmer = &w->keys[words];
+    pack_kmer(w, it, kmer);
+
+    uint64_t p = kmer_partition(s, kmer, 0);
+    copy_kmer(&w->spill[(p * s->spill_length + w->spill_counts[p]) * words], kmer, words);
+    if (++w->spill_counts[p] == s->spill_length)
+    {
+        flush_spill(w, p);
+    }
+}
+
+/**
+ *  Grow the array of worker w so that it holds count more k-mers
+ */
+static void
+reserve_kmers(hsort_worker* w, uint64_t count)
+{
+    if (w->count_kmers + count <= w->capacity)
+    {
+        return;
+    }
+
+    w->capacity = w->capacity * 2 > w->count_kmers + count ? w->capacity * 2 : w->count_kmers + count;
+    w->kmers = realloc(w->kmers, w->capacity * w->sorter->kmer_words * sizeof(uint64_t));
+    assert(w->kmers != NULL && "Could not allocate k-mers");
+}
+
+/**
+ *  Append to the array of worker arg the k-mers ending in its slice of the current batch
+ */
+static void*
+extract_kmers(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    uint64_t key_length = s->g->k - 1;
+
+    const char* batch = s->batch;
+    uint64_t length = s->batch_length;
+
+    hkmer_iter it;
+    hkmer_iter_init(&it, s->g->k);
+
+    if (s->text == NULL)
+    {
+        uint64_t slice = (length + s->count_workers - 1) / s->count_workers;
+        uint64_t begin = w->id * slice < length ? w->id * slice : length;
+        uint64_t end = begin + slice < length ? begin + slice : length;
+
+        // At most one k-mer ends at each character of the slice
+        if (s->count_partitions == 0)
+        {
+            reserve_kmers(w, end - begin);
+        }
+
+        for (uint64_t i = begin > key_length ? begin - key_length : 0; i < end; i++)
+        {
+            if (hkmer_iter_next(&it, batch[i]))
+            {
+                push_kmer(w, &it);
+            }
+        }
+    }
+    else
+    {
+        // Slices are cut anywhere as in hbuilder, so a record on a single line is split between the workers
+        mapped_cut cut;
+        const char* slice_end = mapped_slice(&cut, s->text, &s->start, length, w->id, s->count_workers, key_length);
+        if (s->count_partitions == 0)
+        {
+            reserve_kmers(w, slice_end - cut.p);
+        }
+
+        hkmer_iter_resume_text(&it, cut.line_start, cut.parse_header);
+        for (const char* c = cut.parse; c < slice_end; c++)
+        {
+            if (hkmer_iter_next_text(&it, *c) && c >= cut.p)
+            {
+                push_kmer(w, &it);
+            }
+        }
+    }
+
+    hkmer_iter_destroy(&it);
+
+    return NULL;
+}
+
+/**
+ *  Copy the k-mers of worker arg to the gathered k-mers at its offset, then free its array
+ */
+static void*
+gather_kmers(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+
+    if (w->count_kmers > 0)
+    {
+        memcpy(&s->kmers[w->offset * s->kmer_words], w->kmers, w->count_kmers * s->kmer_words * sizeof(uint64_t));
+    }
+    free(w->kmers);
+    w->kmers = NULL;
+    w->capacity = 0;
+
+    return NULL;
+}
+
+/**
+ *  Return the digit of given index of a packed k-mer of given number of words, 0 for its least significant digit
+ */
+static inline uint8_t
+kmer_digit(const uint64_t* kmer, uint64_t words, uint64_t digit)
+{
+    uint64_t bit = digit * HSORT_DIGIT_BITS;
+
+    return (kmer[words - 1 - bit / 64] >> (bit % 64)) & (HSORT_RADIX - 1);
+}
+
+/**
+ *  Count the k-mers of the range of worker arg having each value of the digit of the current pass
+ */
+static void*
+count_digits(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    uint64_t words = s->kmer_words;
+
+    memset(w->histogram, 0, sizeof(w->histogram));
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        w->histogram[kmer_digit(&s->kmers[i * words], words, s->digit)]++;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Replace the histograms of the workers of s with the offsets their k-mers are moved to, by digit then by
+ *  worker so that the pass is stable. Return false if every k-mer has the same digit, the pass is then useless
+ */
+static bool
+digit_offsets(hsort* s)
+{
+    uint64_t offset = 0;
+
+    for (uint64_t d = 0; d < HSORT_RADIX; d++)
+    {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < s->count_workers; i++)
+        {
+            hsort_worker* w = &s->workers[i];
+            uint64_t histogram = w->histogram[d];
+            w->histogram[d] = offset + count;
+            count += histogram;
+        }
+
+        if (count == s->count_kmers)
+        {
+            return false;
+        }
+        offset += count;
+    }
+
+    return true;
+}
+
+/**
+ *  Move the k-mers of the range of worker arg to the other array of the sort, at the offsets of their digits
+ */
+static void*
+scatter_kmers(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    uint64_t words = s->kmer_words;
+
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        const uint64_t* kmer = &s->kmers[i * words];
+        copy_kmer(&s->buffer[w->histogram[kmer_digit(kmer, words, s->digit)]++ * words], kmer, words);
+    }
+
+    return NULL;
+}
+
+/**
+ *  Sort the gathered k-mers of s with an LSD radix sort, each pass moving them between the two arrays
+ */
+static void
+sort_kmers(hsort* s)
+{
+    uint64_t digits = (2 * s->g->k + HSORT_DIGIT_BITS - 1) / HSORT_DIGIT_BITS;
+    split_ranges(s, s->count_kmers);
+
+    for (s->digit = 0; s->digit < digits; s->digit++)
+    {
+        run_workers(s, count_digits);
+        if (!digit_offsets(s))
+        {
+            continue;
+        }
+        run_workers(s, scatter_kmers);
+
+        uint64_t* sorted = s->buffer;
+        s->buffer = s->kmers;
+        s->kmers = sorted;
+    }
+}
+
+/**
+ *  Move the range of each worker of s but the first one forward to the beginning of a run of equal k-mers, so
+ *  that runs are never split between two workers
+ */
+static void
+split_runs(hsort* s)
+{
+    uint64_t words = s->kmer_words;
+    split_ranges(s, s->count_kmers);
+
+    for (uint64_t i = 1; i < s->count_workers; i++)
+    {
+        uint64_t begin = s->workers[i].begin;
+        while (begin > 0 && begin < s->count_kmers &&
+               hkmer_equal(&s->kmers[begin * words], &s->kmers[(begin - 1) * words], words))
+        {
+            begin++;
+        }
+
+        s->workers[i].begin = begin;
+        s->workers[i - 1].end = begin;
+    }
+}
+
+/**
+ *  Return the end of the run of equal k-mers of s beginning at the given index, the run ending before end
+ */
+static inline uint64_t
+run_end(hsort* s, uint64_t begin, uint64_t end)
+{
+    uint64_t words = s->kmer_words;
+    const uint64_t* kmer = &s->kmers[begin * words];
+
+    uint64_t i = begin + 1;
+    while (i < end && hkmer_equal(&s->kmers[i * words], kmer, words))
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ *  Set the offset of worker arg to the number of runs of its range holding at least min_count k-mers
+ */
+static void*
+count_runs(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+
+    w->offset = 0;
+    for (uint64_t i = w->begin; i < w->end;)
+    {
+        uint64_t end = run_end(s, i, w->end);
+        if (end - i >= s->min_count)
+        {
+            w->offset++;
+        }
+        i = end;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Write the k-mer and the length of each run of the range of worker arg holding at least min_count k-mers to the
+ *  other array of the sort and to the counts, from its offset
+ */
+static void*
+write_runs(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    uint64_t words = s->kmer_words;
+    uint64_t j = w->offset;
+
+    for (uint64_t i = w->begin; i < w->end;)
+    {
+        uint64_t end = run_end(s, i, w->end);
+        if (end - i >= s->min_count)
+        {
+            copy_kmer(&s->buffer[j * words], &s->kmers[i * words], words);
+            s->counts[j++] = end - i < UINT32_MAX ? end - i : UINT32_MAX;
+        }
+        i = end;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Replace the sorted k-mers of s with its distinct k-mers occurring at least min_count times, and count them
+ */
+static void
+merge_runs(hsort* s)
+{
+    split_runs(s);
+    run_workers(s, count_runs);
+
+    uint64_t count_distinct = 0;
+    for (uint64_t i = 0; i < s->count_workers; i++)
+    {
+        uint64_t count = s->workers[i].offset;
+        s->workers[i].offset = count_distinct;
+        count_distinct += count;
+    }
+
+    s->counts = malloc(count_distinct * sizeof(uint32_t) + 1);
+    assert(s->counts != NULL && "Could not allocate k-mer counts");
+    run_workers(s, write_runs);
+
+    free(s->kmers);
+    s->kmers = s->buffer;
+    s->buffer = NULL;
+    s->count_kmers = count_distinct;
+}
+
+/**
+ *  Split a packed k-mer of s into the keys of its edge with the scratch buffer of worker w, then set the sides of
+ *  the edge as hgraph_orient_edge does
+ */
+static inline void
+orient_kmer(hsort_worker* w, const uint64_t* kmer, uint64_t** start, uint8_t* last, uint64_t** end, uint8_t* first)
+{
+    hgraph* g = w->sorter->g;
+    uint64_t words = w->sorter->kmer_words;
+    uint64_t key_words = g->key_words;
+
+    // The prefix is the k-mer without its last base, the suffix is the k-mer without its first base
+    uint64_t* prefix = w->keys;
+    uint64_t* suffix = &w->keys[words];
+    for (uint64_t i = words - 1; i > 0; i--)
+    {
+        prefix[i] = (kmer[i] >> 2) | (kmer[i - 1] << 62);
+    }
+    prefix[0] = kmer[0] >> 2;
+
+    memcpy(suffix, &kmer[words - key_words], key_words * sizeof(uint64_t));
+    suffix[0] &= hkmer_first_word_mask(g->k - 1);
+
+    hgraph_orient_edge(g, &prefix[words - key_words], suffix, &suffix[key_words], start, last, end, first);
+}
+
+/**
+ *  Store the shards and the bases of the two sides of the edge of each distinct k-mer of the range of worker arg,
+ *  and count the sides going to each shard
+ */
+static void*
+find_shards(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    hgraph* g = s->g;
+
+    memset(w->sides, 0, s->count_workers * sizeof(uint64_t));
+    for (uint64_t i = w->begin; i < w->end; i++)
+    {
+        uint64_t* start;
+        uint64_t* end;
+        uint8_t last;
+        uint8_t first;
+        orient_kmer(w, &s->kmers[i * s->kmer_words], &start, &last, &end, &first);
+
+        s->shards[2 * i] = hgraph_shard_index(g, start);
+        s->shards[2 * i + 1] = hgraph_shard_index(g, end);
+        s->bases[2 * i] = last;
+        s->bases[2 * i + 1] = first;
+        w->sides[s->shards[2 * i]]++;
+        w->sides[s->shards[2 * i + 1]]++;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Add to the shard of worker arg every side of an edge belonging to it, in the order of the distinct k-mers,
+ *  with the count of its k-mer as multiplicity, and store the vertex of the side
+ */
+static void*
+insert_sides(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+    hgraph_shard* shard = &s->g->shards[w->id];
+
+    // Most vertices have one incoming and one outgoing side
+    uint64_t count_sides = 0;
+    for (uint64_t i = 0; i < s->count_workers; i++)
+    {
+        count_sides += s->workers[i].sides[w->id];
+    }
+    htable_reserve(shard->vertices, shard->vertices->count + count_sides / 2);
+
+    uint64_t key_words = s->g->key_words;
+    uint64_t* indices = w->prefetched;
+    uint64_t* keys = &w->prefetched[HSORT_PREFETCH_KMERS];
+
+    for (uint64_t i = 0; i < s->count_kmers;)
+    {
+        // Slots are random, so the slots of the next sides of the shard are loaded while they are oriented
+        uint64_t count = 0;
+        for (; i < s->count_kmers && count < HSORT_PREFETCH_KMERS; i++)
+        {
+            if (s->shards[2 * i] != w->id && s->shards[2 * i + 1] != w->id)
+            {
+                continue;
+            }
+
+            uint64_t* start;
+            uint64_t* end;
+            uint8_t last;
+            uint8_t first;
+            orient_kmer(w, &s->kmers[i * s->kmer_words], &start, &last, &end, &first);
+
+            uint64_t* sides = &keys[2 * count * key_words];
+            memcpy(sides, start, key_words * sizeof(uint64_t));
+            memcpy(&sides[key_words], end, key_words * sizeof(uint64_t));
+            if (s->shards[2 * i] == w->id)
+            {
+                htable_prefetch(shard->vertices, sides);
+            }
+            if (s->shards[2 * i + 1] == w->id)
+            {
+                htable_prefetch(shard->vertices, &sides[key_words]);
+            }
+            indices[count++] = i;
+        }
+
+        for (uint64_t j = 0; j < count; j++)
+        {
+            uint64_t k = indices[j];
+            uint64_t* sides = &keys[2 * j * key_words];
+
+            if (s->shards[2 * k] == w->id)
+            {
+                s->vertices[2 * k] = hgraph_shard_add_edge_start(shard, sides, s->bases[2 * k], s->counts[k]);
+            }
+            if (s->shards[2 * k + 1] == w->id)
+            {
+                s->vertices[2 * k + 1] = hgraph_shard_add_edge_end(shard, &sides[key_words], s->bases[2 * k + 1],
+                                                                   s->counts[k]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Link the successors of the vertices of the shard of worker arg, as hgraph_add_edge does for each edge whose
+ *  outgoing side, or reversed incoming side, belongs to the shard
+ */
+static void*
+link_edges(void* arg)
+{
+    hsort_worker* w = arg;
+    hsort* s = w->sorter;
+
+    for (uint64_t i = 0; i < s->count_kmers; i++)
+    {
+        uint8_t last = s->bases[2 * i];
+        uint8_t first = s->bases[2 * i + 1];
+
+        if (s->shards[2 * i] == w->id && !(last & HGRAPH_REVERSE))
+        {
+            hgraph_vertex_link(s->vertices[2 * i], last, s->vertices[2 * i + 1], first & HGRAPH_REVERSE);
+        }
+        if (s->shards[2 * i + 1] == w->id && (first & HGRAPH_REVERSE))
+        {
+            hgraph_vertex_link(s->vertices[2 * i + 1], hkmer_complement_base(first & 3), s->vertices[2 * i],
+                               (last & HGRAPH_REVERSE) ^ HGRAPH_REVERSE);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Append the spill buffers of worker arg to the files of their partitions, then free them
+ */
+static void*
+flush_spills(void* arg)
+{
+    hsort_worker* w = arg;
+
+    for (uint64_t p = 0; p < w->sorter->count_partitions; p++)
+    {
+        if (w->spill_counts[p] > 0)
+        {
+            flush_spill(w, p);
+        }
+    }
+    free(w->spill);
+    free(w->spill_counts);
+    w->spill = NULL;
+    w->spill_counts = NULL;
+
+    return NULL;
+}
+
+/**
+ *  Sort the k-mers of s, then replace them with its distinct k-mers and count them
+ */
+static void
+merge_kmers(hsort* s)
+{
+    // One more word, so that no array is empty
+    s->buffer = malloc((s->count_kmers * s->kmer_words + 1) * sizeof(uint64_t));
+    assert(s->buffer != NULL && "Could not allocate k-mers");
+    sort_kmers(s);
+    merge_runs(s);
+}
+
+/**
+ *  Write the edge of each distinct k-mer of s to the output of its options, as the edges table of its graph would
+ *  be written once the edges are added
+ */
+static void
+write_edges(hsort* s)
+{
+    hgraph* g = s->g;
+    uint64_t* keys = malloc(3 * g->key_words * sizeof(uint64_t));
+    char* line = malloc(3 * g->k + 7);
+    assert(keys != NULL && line != NULL && "Could not allocate edge buffers");
+
+    for (uint64_t i = 0; i < s->count_kmers; i++)
+    {
+        uint64_t* start;
+        uint64_t* end;
+        uint8_t last;
+        uint8_t first;
+        orient_kmer(&s->workers[0], &s->kmers[i * s->kmer_words], &start, &last, &end, &first);
+        hgraph_write_edge(g, s->options->stream, s->options->weighted, start, last, end, first, s->counts[i], keys,
+                          line);
+    }
+
+    free(keys);
+    free(line);
+}
+
+/**
+ *  Add the edges of the distinct k-mers of s to its graph, or write them if they are streamed, then free the
+ *  k-mers
+ */
+static void
+add_edges(hsort* s)
+{
+    if (s->options->stream != NULL)
+    {
+        write_edges(s);
+    }
+    else
+    {
+        s->shards = malloc(2 * s->count_kmers * sizeof(uint16_t) + 1);
+        s->bases = malloc(2 * s->count_kmers * sizeof(uint8_t) + 1);
+        s->vertices = malloc(2 * s->count_kmers * sizeof(hgraph_vertex*) + 1);
+        assert(s->shards != NULL && s->bases != NULL && s->vertices != NULL && "Could not allocate sides of k-mers");
+        split_ranges(s, s->count_kmers);
+        run_workers(s, find_shards);
+        run_workers(s, insert_sides);
+        run_workers(s, link_edges);
+
+        free(s->shards);
+        free(s->bases);
+        free(s->vertices);
+        s->shards = NULL;
+        s->bases = NULL;
+        s->vertices = NULL;
+    }
+
+    free(s->kmers);
+    free(s->counts);
+    s->kmers = NULL;
+    s->counts = NULL;
+}
+
+/**
+ *  Return the number of bytes taken by each k-mer of s while it is counted and its edge is added
+ */
+static uint64_t
+kmer_bytes(hsort* s)
+{
+    // Both arrays of the radix sort, then the count and the sides of a distinct k-mer
+    uint64_t bytes = 2 * s->kmer_words * sizeof(uint64_t) + sizeof(uint32_t);
+    if (s->options->stream == NULL)
+    {
+        bytes += 2 * (sizeof(uint16_t) + sizeof(uint8_t) + sizeof(hgraph_vertex*));
+    }
+
+    return bytes;
+}
+
+static void
+add_partition(hsort* s, int fd, uint64_t level);
+
+/**
+ *  Split the partition of s of descriptor fd and given size, already split level times, into HSORT_SPLIT
+ *  partitions by the next bits of the hashes of its k-mers, close it, then count and add each new partition
+ */
+static void
+split_partition(hsort* s, int fd, uint64_t size, uint64_t level)
+{
+    uint64_t words = s->kmer_words;
+    uint64_t length = s->spill_length;
+    uint64_t chunk_size = length * words * sizeof(uint64_t);
+    uint64_t* chunk = malloc(chunk_size);
+    uint64_t* buffers = malloc(HSORT_SPLIT * chunk_size);
+    assert(chunk != NULL && buffers != NULL && "Could not allocate spill buffers");
+
+    int parts[HSORT_SPLIT];
+    uint64_t counts[HSORT_SPLIT];
+    uint64_t totals[HSORT_SPLIT];
+    for (uint64_t p = 0; p < HSORT_SPLIT; p++)
+    {
+        parts[p] = open_partition();
+        counts[p] = 0;
+        totals[p] = 0;
+    }
+
+    for (uint64_t offset = 0; offset < size; offset += chunk_size)
+    {
+        uint64_t bytes = size - offset < chunk_size ? size - offset : chunk_size;
+        read_kmers(fd, chunk, bytes, offset);
+
+        for (uint64_t i = 0; i < bytes / (words * sizeof(uint64_t)); i++)
+        {
+            const uint64_t* kmer = &chunk[i * words];
+            uint64_t p = kmer_partition(s, kmer, level + 1);
+            copy_kmer(&buffers[(p * length + counts[p]) * words], kmer, words);
+            totals[p]++;
+
+            if (++counts[p] == length)
+            {
+                append_kmers(s, parts[p], &buffers[p * length * words], length);
+                counts[p] = 0;
+            }
+        }
+    }
+
+    for (uint64_t p = 0; p < HSORT_SPLIT; p++)
+    {
+        append_kmers(s, parts[p], &buffers[p * length * words], counts[p]);
+    }
+    free(chunk);
+    free(buffers);
+    close(fd);
+
+    uint64_t count = size / (words * sizeof(uint64_t));
+    for (uint64_t p = 0; p < HSORT_SPLIT; p++)
+    {
+        // A partition holding every k-mer, e.g. of a single repeat, gets no smaller by being split again
+        add_partition(s, parts[p], totals[p] == count ? HSORT_MAX_LEVEL : level + 1);
+    }
+}
+
+/**
+ *  Count the k-mers of the partition of s of descriptor fd, already split level times, add their edges and close
+ *  it. A partition whose k-mers don't fit in the memory budget is split first, unless it has been split
+ *  HSORT_MAX_LEVEL times
+ */
+static void
+add_partition(hsort* s, int fd, uint64_t level)
+{
+    struct stat st;
+    int error = fstat(fd, &st);
+    assert(error == 0 && "Could not read partition file");
+
+    uint64_t size = st.st_size;
+    s->count_kmers = size / (s->kmer_words * sizeof(uint64_t));
+    if (s->count_kmers * kmer_bytes(s) > s->options->max_memory && level < HSORT_MAX_LEVEL)
+    {
+        split_partition(s, fd, size, level);
+        return;
+    }
+
+    s->kmers = malloc(size + sizeof(uint64_t));
+    assert(s->kmers != NULL && "Could not allocate k-mers");
+    read_kmers(fd, s->kmers, size, 0);
+    close(fd);
+
+    merge_kmers(s);
+    add_edges(s);
+}
+
+/**
+ *  Count the k-mers extracted by the workers of s and add their edges to its graph, one partition at a time if
+ *  they have been spilled
+ */
+static void
+build_graph(hsort* s)
+{
+    if (s->options->stream != NULL)
+    {
+        hgraph_write_edges_header(s->g, s->options->stream, s->options->weighted);
+    }
+
+    if (s->count_partitions > 0)
+    {
+        run_workers(s, flush_spills);
+        for (uint64_t p = 0; p < s->count_partitions; p++)
+        {
+            add_partition(s, s->partitions[p], 0);
+        }
+
+        return;
+    }
+
+    s->count_kmers = 0;
+    for (uint64_t i = 0; i < s->count_workers; i++)
+    {
+        s->workers[i].offset = s->count_kmers;
+        s->count_kmers += s->workers[i].count_kmers;
+    }
+
+    s->kmers = malloc((s->count_kmers * s->kmer_words + 1) * sizeof(uint64_t));
+    assert(s->kmers != NULL && "Could not allocate k-mers");
+    run_workers(s, gather_kmers);
+
+    merge_kmers(s);
+    add_edges(s);
+}
+
+/**
+ *  Set the partitions of sorter s for an input of about length characters, 0 if unknown, so that each partition
+ *  fits in the memory budget, and open their files
+ */
+static void
+open_partitions(hsort* s, uint64_t length)
+{
+    uint64_t max_memory = s->options->max_memory;
+
+    // At most one k-mer ends at each character of the input
+    uint64_t count = length > 0 ? (length * kmer_bytes(s) + max_memory - 1) / max_memory : HSORT_PARTITIONS;
+    count = count > 0 ? count : 1;
+    s->count_partitions = count < HSORT_MAX_PARTITIONS ? count : HSORT_MAX_PARTITIONS;
+
+    s->partitions = malloc(s->count_partitions * sizeof(int));
+    assert(s->partitions != NULL && "Could not allocate partitions");
+    for (uint64_t p = 0; p < s->count_partitions; p++)
+    {
+        s->partitions[p] = open_partition();
+    }
+
+    // Spill buffers take at most half of the budget
+    uint64_t bytes = max_memory / (2 * s->count_workers * s->count_partitions);
+    bytes = bytes < HSORT_SPILL_BYTES ? bytes : HSORT_SPILL_BYTES;
+    s->spill_length = bytes / (s->kmer_words * sizeof(uint64_t));
+    s->spill_length = s->spill_length > 0 ? s->spill_length : 1;
+}
+
+/**
+ *  Initialize sorter s for graph g built with the given options from an input of about length characters, 0 if
+ *  unknown
+ */
+static void
+start_sorter(hsort* s, hgraph* g, hgraph_build_options* options, uint64_t length)
+{
+    uint64_t threads = options->threads;
+    assert(g != NULL && "Graph is not initialized");
+    assert(g->count_shards == threads && "Graph must have one shard for each thread");
+    assert(g->min_count == 1 && "Graph must not filter k-mers, they are filtered once sorted");
+    assert(threads <= UINT16_MAX + 1 && "Too many threads to sort k-mers");
+    assert(options->min_count > 0 && "Minimum count must be greater than 0");
+
+    memset(s, 0, sizeof(hsort));
+    s->g = g;
+    s->count_workers = threads;
+    s->workers = calloc(threads, sizeof(hsort_worker));
+    s->options = options;
+    s->min_count = options->min_count;
+    s->kmer_words = hkmer_words(g->k);
+    assert(s->workers != NULL && "Could not allocate sorter");
+
+    if (options->max_memory > 0)
+    {
+        open_partitions(s, length);
+    }
+
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        hsort_worker* w = &s->workers[i];
+        w->sorter = s;
+        w->id = i;
+        w->sides = malloc(threads * sizeof(uint64_t));
+        w->keys = malloc((s->kmer_words + 3 * g->key_words) * sizeof(uint64_t));
+        w->prefetched = malloc(HSORT_PREFETCH_KMERS * (1 + 2 * g->key_words) * sizeof(uint64_t));
+        assert(w->sides != NULL && w->keys != NULL && w->prefetched != NULL && "Could not allocate sorter");
+
+        if (s->count_partitions > 0)
+        {
+            w->spill = malloc(s->count_partitions * s->spill_length * s->kmer_words * sizeof(uint64_t));
+            w->spill_counts = calloc(s->count_partitions, sizeof(uint64_t));
+            assert(w->spill != NULL && w->spill_counts != NULL && "Could not allocate spill buffers");
+        }
+    }
+}
+
+/**
+ *  Build the graph of sorter s from the k-mers extracted from every batch, then free the sorter
+ */
+static void
+finish_sorter(hsort* s)
+{
+    build_graph(s);
+
+    for (uint64_t i = 0; i < s->count_workers; i++)
+    {
+        free(s->workers[i].sides);
+        free(s->workers[i].keys);
+        free(s->workers[i].prefetched);
+    }
+    free(s->workers);
+    free(s->partitions);
+}
+
+/**
+ * @param g An empty hague graph with one shard for each thread, whose k-mers are not filtered
+ * @param p A pipeline
+ * @param options Construction parameters of g, see hgraph_build_options
+ *
+ * Edges are added to g as hbuilder_add_batches would do, each distinct edge once with its number of occurrences,
+ * and successors are linked. K-mers are counted exactly, so filtered k-mers are never added by mistake. Every
+ * k-mer is held in memory until the whole input has been read, unless the options give a memory budget: k-mers
+ * are then spilled to partition files and counted one partition at a time. If the options give an output the
+ * edges are written to it instead, and g stays empty
+ */
+void
+hsort_add_batches(hgraph* g, pipeline* p, hgraph_build_options* options)
+{
+    hsort s;
+    start_sorter(&s, g, options, options->input_length);
+
+    bool validfile = false;
+    pipeline_batch* batch;
+    while ((batch = pipeline_acquire(p)) != NULL)
+    {
+        validfile = true;
+
+        s.batch = batch->data;
+        s.batch_length = batch->length;
+        s.text = p->text ? batch->data : NULL;
+        if (p->text)
+        {
+            mapped_cut_text(&s.start, s.batch, s.batch + s.batch_length, s.batch, g->k - 1, NULL);
+        }
+        run_workers(&s, extract_kmers);
+        pipeline_release(p, batch);
+    }
+    assert(validfile && "Invalid file content");
+
+    finish_sorter(&s);
+}
+
+/**
+ * @param g An empty hague graph with one shard for each thread, whose k-mers are not filtered
+ * @param text FASTA text, e.g. a mapped file
+ * @param length The length of text
+ * @param options Construction parameters of g, see hgraph_build_options
+ *
+ * Edges are added to g as hbuilder_add_text would do, see hsort_add_batches. The whole text is a single batch
+ */
+void
+hsort_add_text(hgraph* g, const char* text, uint64_t length, hgraph_build_options* options)
+{
+    hsort s;
+    start_sorter(&s, g, options, length);
+
+    s.batch = text;
+    s.batch_length = length;
+    s.text = text;
+    mapped_cut_text(&s.start, text, text + length, text, g->k - 1, NULL);
+    run_workers(&s, extract_kmers);
+
+    finish_sorter(&s);
+}
@@ -0,0 +1,153 @@
+#ifndef HAGUE_SORT_H
+#define HAGUE_SORT_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/hgraph.h"
+#include "io/pipeline.h"
+#include "io/mapped.h"
+#include "io/output.h"
+
+/**
+ * Number of bits of a digit of the radix sort
+ */
+#define HSORT_DIGIT_BITS 8
+
+/**
+ * Number of values of a digit of the radix sort
+ */
+#define HSORT_RADIX (1 << HSORT_DIGIT_BITS)
+
+/**
+ * Number of k-mers whose sides are prefetched together before being inserted
+ */
+#define HSORT_PREFETCH_KMERS 32
+
+/**
+ * Number of partitions k-mers are spilled to when the length of the input is unknown
+ */
+#define HSORT_PARTITIONS 16
+
+/**
+ * Maximum number of partitions k-mers are spilled to, each partition being an open file
+ */
+#define HSORT_MAX_PARTITIONS 256
+
+/**
+ * Number of bytes of the largest spill buffer of a worker for a partition
+ */
+#define HSORT_SPILL_BYTES (1 << 20)
+
+/**
+ * Number of hash bits splitting a partition larger than the memory budget into smaller ones
+ */
+#define HSORT_SPLIT_BITS 4
+
+/**
+ * Number of smaller partitions a partition larger than the memory budget is split into
+ */
+#define HSORT_SPLIT (1 << HSORT_SPLIT_BITS)
+
+/**
+ * Maximum number of times a partition is split, each time on the next bits of the low half of the hash
+ */
+#define HSORT_MAX_LEVEL (32 / HSORT_SPLIT_BITS)
+
+typedef struct hsort hsort;
+
+typedef struct hsort_worker hsort_worker;
+
+/** @struct hsort_worker
+    @brief A thread taking part in each phase of the sort-based construction of a graph
+*/
+struct hsort_worker
+{
+    hsort* sorter; /**< Sorter the worker belongs to */
+    uint64_t id; /**< Index of the worker, which is also the index of the shard it inserts into */
+    pthread_t thread; /**< Thread running the worker, unused for worker 0 which runs on the calling thread */
+    uint64_t* kmers; /**< K-mers extracted by the worker, kmer_words words each */
+    uint64_t count_kmers; /**< Number of k-mers extracted by the worker */
+    uint64_t capacity; /**< Number of k-mers the array of the worker can hold */
+    uint64_t begin; /**< First k-mer of the range of the worker in the current phase */
+    uint64_t end; /**< End of the range of the worker in the current phase */
+    uint64_t offset; /**< Index of the first k-mer written by the worker in the current phase */
+    uint64_t histogram[HSORT_RADIX]; /**< Number of k-mers of the range having each digit, then their offsets */
+    uint64_t* sides; /**< Number of edge sides of distinct k-mers of the range in each shard */
+    uint64_t* keys; /**< Scratch buffer of a k-mer and 3 vertex keys, to split and orient a k-mer */
+    uint64_t* prefetched; /**< Indices of the k-mers being prefetched, then the keys of both of their sides */
+    uint64_t* spill; /**< Spill buffers of the worker, spill_length k-mers for each partition */
+    uint64_t* spill_counts; /**< Number of k-mers in the spill buffer of each partition */
+};
+
+/** @struct hsort
+    @brief Construction of a De Bruijn graph by sorting its k-mers instead of inserting them one at a time
+
+    Each batch is split between the workers, which extract the packed k-mers ending in their slice into arrays of
+    their own, folded with their reverse complements if the graph is canonical. Once the whole input has been
+    read, the k-mers are gathered into a single array sorted by a parallel LSD radix sort, one digit at a time from
+    the least significant one: each worker counts the digits of its range, then moves its k-mers to their
+    offset in the other array, so every pass reads and writes memory sequentially. Equal k-mers are then
+    adjacent and each run of equal k-mers is counted by a linear scan, dropping runs shorter than min_count.
+
+    Each distinct k-mer is an edge added once with its count as multiplicity. Workers first find the shards of
+    the two sides of each edge, then each worker inserts into its own shard the sides belonging to it, in the
+    sorted order of the k-mers, so no lock is needed and the graph only depends on the input and the number of
+    threads. The vertex of each side is kept, so successors are linked from the edges without hashing any key.
+
+    With a memory budget, workers don't keep their k-mers: each k-mer goes to the spill buffer of the partition
+    given by the high bits of its hash, which is appended to a temporary file of the partition once full, so the
+    k-mers held in memory don't depend on the length of the input. Equal k-mers are in the same partition, so once
+    the whole input has been read each partition is sorted and counted on its own as above, one at a time. A
+    partition larger than the budget, e.g. for a skewed input, is split again into HSORT_SPLIT files by the next
+    bits of the hash before being counted. The distinct k-mers of each partition are either added to the graph,
+    which then grows with the number of distinct k-mers, or written as edges to an output, leaving the graph empty.
+*/
+struct hsort
+{
+    hgraph* g; /**< Graph being built, with one shard for each worker */
+    uint64_t count_workers; /**< Number of workers */
+    hsort_worker* workers; /**< Workers */
+    hgraph_build_options* options; /**< Construction parameters of the graph */
+    uint64_t min_count; /**< Number of occurrences of a k-mer before its edge is added */
+    uint64_t kmer_words; /**< Number of words of a packed k-mer */
+    const char* batch; /**< Characters of the current batch */
+    uint64_t batch_length; /**< Number of characters of the current batch */
+    const char* text; /**< Beginning of the FASTA text the batch is a chunk of, NULL if it holds bare sequences */
+    mapped_cut start; /**< Cut of the text at the beginning of the batch, if it is a chunk of FASTA text */
+    uint64_t count_kmers; /**< Number of k-mers, then of distinct k-mers */
+    uint64_t* kmers; /**< Gathered k-mers, sorted in place, then the distinct k-mers */
+    uint64_t* buffer; /**< Other array of the radix sort */
+    uint32_t* counts; /**< Number of occurrences of each distinct k-mer */
+    uint16_t* shards; /**< Shards of the outgoing and incoming sides of each distinct k-mer */
+    uint8_t* bases; /**< Bases of the outgoing and incoming sides of each distinct k-mer, see hgraph_orient_edge */
+    hgraph_vertex** vertices; /**< Vertices of the outgoing and incoming sides of each distinct k-mer */
+    uint64_t digit; /**< Index of the digit of the current pass, 0 for the least significant one */
+    uint64_t count_partitions; /**< Number of partitions k-mers are spilled to, 0 to keep them in memory */
+    int* partitions; /**< Descriptors of the temporary files of the partitions */
+    uint64_t spill_length; /**< Number of k-mers of a spill buffer */
+};
+
+/**
+ *
+ * @brief Add the k-mers of every batch of a pipeline to an hague graph with one shard for each thread, by sorting
+ */
+void
+hsort_add_batches(hgraph*, pipeline*, hgraph_build_options*);
+
+/**
+ *
+ * @brief Add the k-mers of a FASTA text to an hague graph with one shard for each thread, by sorting
+ */
+void
+hsort_add_text(hgraph*, const char*, uint64_t, hgraph_build_options*);
+
+#endif
@@ -0,0 +1,509 @@
+#include "hstore.h"
+
+/**
+ * Number of bytes buffered by a writer before they are written to its file
+ */
+#define HSTORE_BUFFER_LENGTH ((uint64_t) 1 << 20)
+
+/**
+ * Maximum number of bytes given to a single call of crc32, whose length is an unsigned int
+ */
+#define HSTORE_CRC_CHUNK ((uint64_t) 1 << 30)
+
+/**
+ *  Return the CRC32 crc updated with the length bytes at data
+ */
+static uLong
+update_crc(uLong crc, const uint8_t* data, uint64_t length)
+{
+    for (uint64_t i = 0; i < length; i += HSTORE_CRC_CHUNK)
+    {
+        uint64_t n = length - i < HSTORE_CRC_CHUNK ? length - i : HSTORE_CRC_CHUNK;
+        crc = crc32(crc, &data[i], n);
+    }
+
+    return crc;
+}
+
+/**
+ *  Write the buffered bytes of w to its file
+ */
+static void
+flush_writer(hstore_writer* w)
+{
+    w->crc = update_crc(w->crc, w->buffer, w->length);
+    uint64_t n = fwrite(w->buffer, 1, w->length, w->file);
+    assert(n == w->length && "Could not write graph file");
+
+    w->length = 0;
+}
+
+/**
+ *  Append length bytes of data to the file of w
+ */
+static void
+write_bytes(hstore_writer* w, const void* data, uint64_t length)
+{
+    if (w->length + length > HSTORE_BUFFER_LENGTH)
+    {
+        flush_writer(w);
+    }
+
+    memcpy(&w->buffer[w->length], data, length);
+    w->length += length;
+}
+
+/**
+ *  Append multiplicity to the file of w, stored with the given number of bytes
+ */
+static void
+write_multiplicity(hstore_writer* w, uint32_t multiplicity, uint64_t bytes)
+{
+    if (bytes == 1)
+    {
+        uint8_t m = multiplicity;
+        write_bytes(w, &m, 1);
+    }
+    else if (bytes == 2)
+    {
+        uint16_t m = multiplicity;
+        write_bytes(w, &m, 2);
+    }
+    else
+    {
+        write_bytes(w, &multiplicity, 4);
+    }
+}
+
+/**
+ *  Append to the file of w the given section of vertex v stored as key: 0 for its key, 1 for its masks, 2 for
+ *  its multiplicities
+ */
+static void
+write_vertex(hstore_writer* w, hgraph* g, const uint64_t* key, hgraph_vertex* v, int section, uint64_t bytes)
+{
+    if (section == 0)
+    {
+        write_bytes(w, key, g->key_words * sizeof(uint64_t));
+        return;
+    }
+
+    if (section == 1)
+    {
+        uint8_t masks[2] = { v->successors, v->predecessors };
+        write_bytes(w, masks, 2);
+        return;
+    }
+
+    for (uint8_t base = 0; base < 4; base++)
+    {
+        if (hgraph_vertex_has_successor(v, base))
+        {
+            write_multiplicity(w, v->out_multiplicity[base], bytes);
+        }
+    }
+
+    for (uint8_t base = 0; base < 4; base++)
+    {
+        if ((v->predecessors >> base) & 1)
+        {
+            write_multiplicity(w, v->in_multiplicity[base], bytes);
+        }
+    }
+}
+
+/**
+ *  Fill the header h of graph g, the multiplicities being stored with as few bytes as possible
+ */
+static void
+fill_header(hgraph* g, hstore_header* h)
+{
+    memset(h, 0, sizeof(hstore_header));
+    memcpy(h->magic, HSTORE_MAGIC, sizeof(HSTORE_MAGIC));
+    h->version = HSTORE_VERSION;
+    h->flags = g->canonical ? HSTORE_CANONICAL : 0;
+    h->k = g->k;
+    h->count_vertices = hgraph_vertex_count(g);
+    h->count_edges = hgraph_edge_count(g);
+
+    uint32_t max_multiplicity = 0;
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v == NULL)
+            {
+                continue;
+            }
+
+            h->count_sides += __builtin_popcount(v->successors) + __builtin_popcount(v->predecessors);
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                max_multiplicity = v->out_multiplicity[base] > max_multiplicity ? v->out_multiplicity[base]
+                                                                                 : max_multiplicity;
+                max_multiplicity = v->in_multiplicity[base] > max_multiplicity ? v->in_multiplicity[base]
+                                                                                : max_multiplicity;
+            }
+        }
+    }
+
+    h->multiplicity_bytes = max_multiplicity <= UINT8_MAX ? 1 : max_multiplicity <= UINT16_MAX ? 2 : 4;
+}
+
+/**
+ * @param g An initialized hague graph
+ * @param filename Name of the output file
+ *
+ * Vertices are written in the order of the shards of g and of their slots, see hstore_header for the format
+ */
+void
+hgraph_save(hgraph* g, const char* filename)
+{
+    assert(g != NULL && "Graph is not initialized");
+
+    hstore_header h;
+    fill_header(g, &h);
+
+    hstore_writer w;
+    w.file = fopen(filename, "wb");
+    w.crc = crc32(0, Z_NULL, 0);
+    w.buffer = malloc(HSTORE_BUFFER_LENGTH);
+    w.length = 0;
+    assert(w.file != NULL && w.buffer != NULL && "Could not open graph file");
+
+    write_bytes(&w, &h, sizeof(hstore_header));
+
+    // Arrays are written one after the other, so each one can be read in bulk
+    for (int section = 0; section < 3; section++)
+    {
+        for (uint64_t s = 0; s < g->count_shards; s++)
+        {
+            htable* vertices = g->shards[s].vertices;
+
+            for (uint64_t i = 0; i < vertices->capacity; i++)
+            {
+                hgraph_vertex* v = vertices->values[i];
+                if (v != NULL)
+                {
+                    write_vertex(&w, g, htable_key_at(vertices, i), v, section, h.multiplicity_bytes);
+                }
+            }
+        }
+    }
+
+    flush_writer(&w);
+
+    uint32_t crc = w.crc;
+    uint64_t n = fwrite(&crc, sizeof(uint32_t), 1, w.file);
+    int error = fclose(w.file);
+    assert(n == 1 && error == 0 && "Could not write graph file");
+
+    free(w.buffer);
+}
+
+/**
+ *  Read length bytes of f into a new array, updating crc with them
+ */
+static uint8_t*
+read_section(FILE* f, uint64_t length, uLong* crc)
+{
+    uint8_t* data = malloc(length + 1);
+    assert(data != NULL && "Could not allocate graph file");
+
+    uint64_t n = fread(data, 1, length, f);
+    assert(n == length && "Truncated graph file");
+    *crc = update_crc(*crc, data, length);
+
+    return data;
+}
+
+/**
+ *  Return the i-th multiplicity of the graph loaded by l
+ */
+static inline uint32_t
+read_multiplicity(hstore_loader* l, uint64_t i)
+{
+    if (l->header.multiplicity_bytes == 1)
+    {
+        return l->multiplicities[i];
+    }
+
+    if (l->header.multiplicity_bytes == 2)
+    {
+        uint16_t m;
+        memcpy(&m, &l->multiplicities[2 * i], 2);
+        return m;
+    }
+
+    uint32_t m;
+    memcpy(&m, &l->multiplicities[4 * i], 4);
+    return m;
+}
+
+/**
+ *  Return the number of edge sides of the vertex of given masks, i.e. of its stored multiplicities
+ */
+static inline uint64_t
+count_vertex_sides(uint8_t successors, uint8_t predecessors)
+{
+    return __builtin_popcount(successors) + __builtin_popcount(predecessors);
+}
+
+/**
+ *  Find the shard of each vertex of the range of worker w, and count the vertices of each shard and the edge
+ *  sides of the range
+ */
+static void*
+find_shards(void* arg)
+{
+    hstore_worker* w = arg;
+    hstore_loader* l = w->loader;
+
+    memset(w->counts, 0, l->g->count_shards * sizeof(uint64_t));
+    w->count_sides = 0;
+    for (uint64_t i = w->first; i < w->last; i++)
+    {
+        l->shards[i] = hgraph_shard_index(l->g, &l->keys[i * l->g->key_words]);
+        w->counts[l->shards[i]]++;
+        w->count_sides += count_vertex_sides(l->masks[2 * i], l->masks[2 * i + 1]);
+    }
+
+    return NULL;
+}
+
+/**
+ *  Set the offsets of the workers of l in the vertices grouped by shard and in the multiplicities, in the order
+ *  of the shards then of the workers, so that the vertices of a shard keep the order of the file
+ */
+static void
+group_offsets(hstore_loader* l)
+{
+    uint64_t count_shards = l->g->count_shards;
+    uint64_t offset = 0;
+    for (uint64_t s = 0; s < count_shards; s++)
+    {
+        l->shard_starts[s] = offset;
+        for (uint64_t i = 0; i < l->count_workers; i++)
+        {
+            uint64_t count = l->workers[i].counts[s];
+            l->workers[i].counts[s] = offset;
+            offset += count;
+        }
+    }
+    l->shard_starts[count_shards] = offset;
+
+    uint64_t side = 0;
+    for (uint64_t i = 0; i < l->count_workers; i++)
+    {
+        uint64_t count = l->workers[i].count_sides;
+        l->workers[i].count_sides = side;
+        side += count;
+    }
+}
+
+/**
+ *  Move the vertices of the range of worker w to their shard in the grouped vertices, and store the index of
+ *  the first multiplicity of each of them
+ */
+static void*
+group_vertices(void* arg)
+{
+    hstore_worker* w = arg;
+    hstore_loader* l = w->loader;
+
+    uint64_t side = w->count_sides;
+    for (uint64_t i = w->first; i < w->last; i++)
+    {
+        l->order[w->counts[l->shards[i]]++] = i;
+        l->sides[i] = side;
+        side += count_vertex_sides(l->masks[2 * i], l->masks[2 * i + 1]);
+    }
+
+    return NULL;
+}
+
+/**
+ *  Insert the vertices of the shards of worker w, with their masks and multiplicities
+ */
+static void*
+insert_vertices(void* arg)
+{
+    hstore_worker* w = arg;
+    hstore_loader* l = w->loader;
+    hgraph* g = l->g;
+
+    for (uint64_t s = w->id; s < g->count_shards; s += l->count_workers)
+    {
+        hgraph_shard* shard = &g->shards[s];
+        htable_reserve(shard->vertices, l->shard_starts[s + 1] - l->shard_starts[s]);
+
+        for (uint64_t j = l->shard_starts[s]; j < l->shard_starts[s + 1]; j++)
+        {
+            uint64_t i = l->order[j];
+            uint64_t side = l->sides[i];
+            uint8_t successors = l->masks[2 * i];
+            uint8_t predecessors = l->masks[2 * i + 1];
+
+            hgraph_vertex* v = hgraph_shard_add_vertex(shard, &l->keys[i * g->key_words]);
+            v->successors = successors;
+            v->predecessors = predecessors;
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                if ((successors >> base) & 1)
+                {
+                    v->out_multiplicity[base] = read_multiplicity(l, side++);
+                }
+            }
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                if ((predecessors >> base) & 1)
+                {
+                    v->in_multiplicity[base] = read_multiplicity(l, side++);
+                }
+            }
+
+            // Both sides of each edge are counted in a canonical graph, see hgraph_load
+            shard->count_edges += hgraph_vertex_outdegree(v) + (g->canonical ? hgraph_vertex_indegree(v) : 0);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Link the successors of the vertices of the shards of worker w and classify them by the balance of their
+ *  degrees, which have been set directly
+ */
+static void*
+link_shards(void* arg)
+{
+    hstore_worker* w = arg;
+    hstore_loader* l = w->loader;
+
+    for (uint64_t s = w->id; s < l->g->count_shards; s += l->count_workers)
+    {
+        hgraph_link_shard(l->g, s);
+        hgraph_count_shard(l->g, s);
+    }
+
+    return NULL;
+}
+
+/**
+ *  Run fn on every worker of l, worker 0 on the calling thread, and wait for all of them
+ */
+static void
+run_workers(hstore_loader* l, void* (*fn)(void*))
+{
+    for (uint64_t i = 1; i < l->count_workers; i++)
+    {
+        int error = pthread_create(&l->workers[i].thread, NULL, fn, &l->workers[i]);
+        assert(error == 0 && "Could not create loading thread");
+    }
+
+    fn(&l->workers[0]);
+
+    for (uint64_t i = 1; i < l->count_workers; i++)
+    {
+        pthread_join(l->workers[i].thread, NULL);
+    }
+}
+
+/**
+ * @param filename Name of a file written by hgraph_save
+ * @param threads Number of threads inserting the vertices, must be greater than 0
+ * @return The saved hague graph, with one shard for each thread
+ *
+ * The whole file is read and its checksum verified before any vertex is inserted, see hstore_loader
+ */
+hgraph*
+hgraph_load(const char* filename, uint64_t threads)
+{
+    assert(threads > 0 && "Number of threads must be greater than 0");
+
+    FILE* f = fopen(filename, "rb");
+    assert(f != NULL && "Could not open graph file");
+
+    hstore_loader l;
+    hstore_header* h = &l.header;
+    uint64_t n = fread(h, sizeof(hstore_header), 1, f);
+    assert(n == 1 && memcmp(h->magic, HSTORE_MAGIC, sizeof(HSTORE_MAGIC)) == 0 && "Not a graph file");
+    assert(h->version == HSTORE_VERSION && "Unsupported graph file version");
+    assert(h->k > 1 && "k-mer length must be greater than 1");
+
+    uint64_t key_words = hkmer_words(h->k - 1);
+    uLong crc = update_crc(crc32(0, Z_NULL, 0), (const uint8_t*) h, sizeof(hstore_header));
+    l.keys = (uint64_t*) read_section(f, h->count_vertices * key_words * sizeof(uint64_t), &crc);
+    l.masks = read_section(f, 2 * h->count_vertices, &crc);
+    l.multiplicities = read_section(f, h->count_sides * h->multiplicity_bytes, &crc);
+
+    uint32_t stored_crc;
+    n = fread(&stored_crc, sizeof(uint32_t), 1, f);
+    assert(n == 1 && stored_crc == crc && "Corrupted graph file");
+    fclose(f);
+
+    hgraph* g = hgraph_create_sharded(h->k, threads);
+    g->canonical = h->flags & HSTORE_CANONICAL;
+
+    l.g = g;
+    l.count_workers = threads;
+    l.workers = malloc(threads * sizeof(hstore_worker));
+    l.shards = malloc(h->count_vertices * sizeof(uint32_t) + 1);
+    l.sides = malloc(h->count_vertices * sizeof(uint64_t) + 1);
+    l.order = malloc(h->count_vertices * sizeof(uint64_t) + 1);
+    l.shard_starts = malloc((g->count_shards + 1) * sizeof(uint64_t));
+    assert(l.workers != NULL && l.shards != NULL && l.sides != NULL && l.order != NULL && l.shard_starts != NULL
+           && "Could not allocate graph loading");
+
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        hstore_worker* w = &l.workers[i];
+        w->loader = &l;
+        w->id = i;
+        w->first = h->count_vertices * i / threads;
+        w->last = h->count_vertices * (i + 1) / threads;
+        w->counts = malloc(g->count_shards * sizeof(uint64_t));
+        assert(w->counts != NULL && "Could not allocate graph loading");
+    }
+
+    run_workers(&l, find_shards);
+    group_offsets(&l);
+    run_workers(&l, group_vertices);
+    run_workers(&l, insert_vertices);
+    run_workers(&l, link_shards);
+
+    // Each edge of a canonical graph has been counted by both its sides, which may be in different shards
+    if (g->canonical)
+    {
+        uint64_t carry = 0;
+        for (uint64_t s = 0; s < g->count_shards; s++)
+        {
+            uint64_t count = g->shards[s].count_edges + carry;
+            g->shards[s].count_edges = count / 2;
+            carry = count % 2;
+        }
+    }
+    assert(hgraph_edge_count(g) == h->count_edges && "Corrupted graph file");
+
+    free(l.keys);
+    free(l.masks);
+    free(l.multiplicities);
+    free(l.shards);
+    free(l.sides);
+    free(l.order);
+    free(l.shard_starts);
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        free(l.workers[i].counts);
+    }
+    free(l.workers);
+
+    return g;
+}
@@ -0,0 +1,122 @@
+#ifndef HAGUE_STORE_H
+#define HAGUE_STORE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/hgraph.h"
+
+/**
+ * First bytes of a saved graph, the terminator included
+ */
+#define HSTORE_MAGIC "HAGUEGR"
+
+/**
+ * Version of the format of saved graphs, incremented on every incompatible change
+ */
+#define HSTORE_VERSION 1
+
+/**
+ * Flag of a saved graph whose k-mers are folded with their reverse complements
+ */
+#define HSTORE_CANONICAL 1
+
+typedef struct hstore_header hstore_header;
+
+typedef struct hstore_writer hstore_writer;
+
+typedef struct hstore_loader hstore_loader;
+
+typedef struct hstore_worker hstore_worker;
+
+/** @struct hstore_header
+    @brief Beginning of a saved graph
+
+    A saved graph is made of this header followed by three arrays, in the byte order of the machine which saved
+    it: the packed key of each vertex, key_words words each, the successors and predecessors masks of each
+    vertex, 2 bytes each, and the multiplicity of each edge side, multiplicity_bytes bytes each, in the order of
+    the vertices then of the bases, outgoing sides first. The file ends with the CRC32 of everything before it.
+*/
+struct hstore_header
+{
+    char magic[8]; /**< HSTORE_MAGIC */
+    uint32_t version; /**< HSTORE_VERSION */
+    uint32_t flags; /**< HSTORE_CANONICAL if the graph is canonical */
+    uint64_t k; /**< Length of the k-mers */
+    uint64_t count_vertices; /**< Number of vertices */
+    uint64_t count_edges; /**< Number of edges, counted once for each time they have been added */
+    uint64_t count_sides; /**< Number of stored multiplicities, i.e. of bits set in the masks */
+    uint64_t multiplicity_bytes; /**< Number of bytes of a multiplicity, 1, 2 or 4 */
+};
+
+/** @struct hstore_writer
+    @brief A buffered writer of a saved graph, computing its checksum
+*/
+struct hstore_writer
+{
+    FILE* file; /**< Output file */
+    uLong crc; /**< CRC32 of the bytes written so far */
+    uint8_t* buffer; /**< Bytes not written yet */
+    uint64_t length; /**< Number of bytes of the buffer */
+};
+
+/** @struct hstore_worker
+    @brief A thread inserting the vertices of some of the shards of a loaded graph
+*/
+struct hstore_worker
+{
+    hstore_loader* loader; /**< Loading the worker belongs to */
+    uint64_t id; /**< Index of the worker, which inserts into the shards whose index is id modulo the workers */
+    pthread_t thread; /**< Thread running the worker, unused for worker 0 which runs on the calling thread */
+    uint64_t first; /**< First vertex of the range of the worker */
+    uint64_t last; /**< End of the range of the worker */
+    uint64_t* counts; /**< Number of vertices of the range in each shard, then the index in order of the next one */
+    uint64_t count_sides; /**< Number of edge sides of the range, then the index of its first multiplicity */
+};
+
+/** @struct hstore_loader
+    @brief Parallel insertion of the vertices of a saved graph into a sharded "Hague Graph"
+
+    The arrays of the file are read in bulk, then the vertices are inserted in four passes: each worker finds
+    the shard of each vertex of a range and counts the vertices of each shard and the edge sides of the range,
+    then groups the vertices of its range by shard, then inserts the vertices of its own shards, then links their
+    successors. Vertices are grouped as by a counting sort, so each pass reads each vertex once whatever the
+    number of threads, and the vertices of a shard keep the order of the file.
+*/
+struct hstore_loader
+{
+    hgraph* g; /**< Graph being loaded */
+    hstore_header header; /**< Header of the file */
+    uint64_t count_workers; /**< Number of workers */
+    hstore_worker* workers; /**< Workers */
+    uint64_t* keys; /**< Packed keys of the vertices */
+    uint8_t* masks; /**< Successors and predecessors masks of the vertices */
+    uint8_t* multiplicities; /**< Multiplicities of the edge sides */
+    uint32_t* shards; /**< Index of the shard of each vertex */
+    uint64_t* sides; /**< Index of the first multiplicity of each vertex */
+    uint64_t* order; /**< Indices of the vertices grouped by shard, in the order of the file within a shard */
+    uint64_t* shard_starts; /**< Index in order of the first vertex of each shard, count_shards + 1 entries */
+};
+
+/**
+ *
+ * @brief Save an hague graph to a binary file, which can be loaded by hgraph_load
+ */
+void
+hgraph_save(hgraph*, const char*);
+
+/**
+ *
+ * @brief Load an hague graph saved by hgraph_save with one shard for each of a given number of threads
+ */
+hgraph*
+hgraph_load(const char*, uint64_t);
+
+#endif
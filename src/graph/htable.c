@@ -0,0 +1,245 @@
+#include "htable.h"
+
+/**
+ * Initial number of slots of a table
+ */
+#define HTABLE_INITIAL_CAPACITY 1024
+
+/**
+ * Value of a slot claimed by a thread which has not published its value yet
+ */
+#define HTABLE_BUSY ((void*) 1)
+
+/**
+ *  Return the index of the slot holding key, or of the empty slot where key should be inserted
+ */
+static inline uint64_t
+find_slot(htable* t, const uint64_t* key)
+{
+    uint64_t mask = t->capacity - 1;
+    uint64_t i = hkmer_hash(key, t->key_words) & mask;
+
+    while (t->values[i] != NULL && !hkmer_equal(htable_key_at(t, i), key, t->key_words))
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/**
+ *  Allocate the slots of table t for a given capacity
+ */
+static void
+allocate_slots(htable* t, uint64_t capacity)
+{
+    t->capacity = capacity;
+    t->keys = malloc(capacity * t->key_words * sizeof(uint64_t));
+    t->values = calloc(capacity, sizeof(void*));
+    assert(t->keys != NULL && t->values != NULL && "Could not allocate hash table");
+}
+
+/**
+ *  Double the capacity of table t, moving every key to its new slot
+ */
+static void
+grow(htable* t)
+{
+    uint64_t old_capacity = t->capacity;
+    uint64_t* old_keys = t->keys;
+    void** old_values = t->values;
+
+    allocate_slots(t, old_capacity * 2);
+
+    for (uint64_t i = 0; i < old_capacity; i++)
+    {
+        if (old_values[i] != NULL)
+        {
+            uint64_t* key = &old_keys[i * t->key_words];
+            uint64_t j = find_slot(t, key);
+            memcpy(htable_key_at(t, j), key, t->key_words * sizeof(uint64_t));
+            t->values[j] = old_values[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_values);
+}
+
+/**
+ * @param key_words Number of words of the packed keys
+ * @return An empty table
+ */
+htable*
+htable_create(uint64_t key_words)
+{
+    htable* t = malloc(sizeof(htable));
+    t->key_words = key_words;
+    t->count = 0;
+    t->fixed = false;
+    allocate_slots(t, HTABLE_INITIAL_CAPACITY);
+
+    return t;
+}
+
+/**
+ * @param key_words Number of words of the packed keys
+ * @param count Maximum number of keys of the table
+ * @return An empty table with enough slots to hold count keys under the maximum load factor
+ */
+htable*
+htable_create_fixed(uint64_t key_words, uint64_t count)
+{
+    uint64_t capacity = HTABLE_INITIAL_CAPACITY;
+    while (count * 10 > capacity * 7)
+    {
+        capacity *= 2;
+    }
+
+    htable* t = malloc(sizeof(htable));
+    t->key_words = key_words;
+    t->count = 0;
+    t->fixed = true;
+    allocate_slots(t, capacity);
+
+    return t;
+}
+
+/**
+ * @param t An initialized table which is not fixed
+ * @param count Number of keys t will hold
+ *
+ * Inserting count keys in total then never moves the keys already inserted
+ */
+void
+htable_reserve(htable* t, uint64_t count)
+{
+    assert(!t->fixed && "Fixed hash table can't grow");
+
+    while (count * 10 > t->capacity * 7)
+    {
+        grow(t);
+    }
+}
+
+/**
+ * @param t An initialized table
+ */
+void
+htable_destroy(htable* t)
+{
+    assert(t != NULL && "Table is not initialized");
+
+    free(t->keys);
+    free(t->values);
+    free(t);
+}
+
+/**
+ * @param t An initialized table
+ * @param key A packed key
+ * @return The value associated to key, NULL if t doesn't contain key
+ */
+void*
+htable_get(htable* t, const uint64_t* key)
+{
+    return t->values[find_slot(t, key)];
+}
+
+/**
+ * @param t An initialized table
+ * @param key A packed key, which must be in t
+ * @return The index of the slot of key, valid until the next insertion
+ */
+uint64_t
+htable_slot(htable* t, const uint64_t* key)
+{
+    uint64_t i = find_slot(t, key);
+    assert(t->values[i] != NULL && "Key is not in the table");
+
+    return i;
+}
+
+/**
+ * @param t An initialized table
+ * @param key A packed key
+ * @param inserted Set to true if key was not in t
+ * @return The value slot of key, which must be set to a non NULL value by the caller if key has been inserted
+ *
+ * The returned slot is only valid until the next insertion
+ */
+void**
+htable_insert(htable* t, const uint64_t* key, bool* inserted)
+{
+    // Keep the load factor under 70%, probe sequences get long quickly above it
+    if ((t->count + 1) * 10 > t->capacity * 7)
+    {
+        assert(!t->fixed && "Fixed hash table is full");
+        grow(t);
+    }
+
+    uint64_t i = find_slot(t, key);
+    *inserted = t->values[i] == NULL;
+
+    if (*inserted)
+    {
+        memcpy(htable_key_at(t, i), key, t->key_words * sizeof(uint64_t));
+        t->count++;
+    }
+
+    return &t->values[i];
+}
+
+/**
+ * @param t An initialized fixed table
+ * @param key A packed key
+ * @param inserted Set to true if key was not in t
+ * @return The value slot of key, whose value must be set with htable_publish by the caller if key has been inserted
+ *
+ * Several threads can call this function at the same time. The first thread inserting a key claims an empty
+ * slot by swapping its value to a busy marker, then writes the key. Threads looking for a key in a busy slot
+ * wait for its value to be published, which happens right after the key has been written.
+ */
+void**
+htable_claim(htable* t, const uint64_t* key, bool* inserted)
+{
+    assert(t->fixed && "Concurrent insertions require a fixed table");
+
+    uint64_t mask = t->capacity - 1;
+    uint64_t i = hkmer_hash(key, t->key_words) & mask;
+
+    for (;;)
+    {
+        void* value = __atomic_load_n(&t->values[i], __ATOMIC_ACQUIRE);
+
+        if (value == NULL)
+        {
+            if (__atomic_compare_exchange_n(&t->values[i], &value, HTABLE_BUSY, false, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_ACQUIRE))
+            {
+                memcpy(htable_key_at(t, i), key, t->key_words * sizeof(uint64_t));
+
+                uint64_t count = __atomic_add_fetch(&t->count, 1, __ATOMIC_RELAXED);
+                assert(count * 10 <= t->capacity * 7 && "Fixed hash table is full");
+
+                *inserted = true;
+                return &t->values[i];
+            }
+
+            // Another thread claimed the slot first, value is now the one it stored
+        }
+
+        while (value == HTABLE_BUSY)
+        {
+            value = __atomic_load_n(&t->values[i], __ATOMIC_ACQUIRE);
+        }
+
+        if (hkmer_equal(htable_key_at(t, i), key, t->key_words))
+        {
+            *inserted = false;
+            return &t->values[i];
+        }
+
+        i = (i + 1) & mask;
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef HAGUE_TABLE_H
+#define HAGUE_TABLE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include "graph/hkmer.h"
+
+typedef struct htable htable;
+
+/** @struct htable
+    @brief An open-addressing hash table from packed k-mers to pointers
+
+    Slots are probed linearly, keys are stored inline in a single array (structure of arrays layout) so a
+    lookup touches one cache line of keys and one of values in the common case. A slot is empty when its
+    value is NULL, so NULL can't be stored as a value.
+
+    A fixed table never grows, which allows several threads to insert keys at the same time with
+    htable_claim and htable_publish: slots are claimed with a compare and swap on their value, without locks.
+*/
+struct htable
+{
+    uint64_t key_words; /**< Number of words of a packed key */
+    uint64_t capacity; /**< Number of slots, always a power of 2 */
+    uint64_t count; /**< Number of used slots */
+    bool fixed; /**< True if the capacity never changes, as required by concurrent insertions */
+    uint64_t* keys; /**< Packed keys, key_words words for each slot */
+    void** values; /**< Values, NULL for empty slots */
+};
+
+/**
+ * @brief Create an empty table for keys of a given number of words
+ *
+ * @return initialized table
+ */
+htable*
+htable_create(uint64_t);
+
+/**
+ * @brief Create an empty fixed table for at most a given number of keys of a given number of words
+ *
+ * @return initialized table
+ */
+htable*
+htable_create_fixed(uint64_t, uint64_t);
+
+/**
+ *
+ * @brief Grow a table which is not fixed so that it holds a given number of keys without growing again
+ */
+void
+htable_reserve(htable*, uint64_t);
+
+/**
+ *
+ * @brief Destroy table t, values are not freed
+ */
+void
+htable_destroy(htable*);
+
+/**
+ *
+ * @brief Return the value associated to a key, NULL if the key is not in the table
+ */
+void*
+htable_get(htable*, const uint64_t*);
+
+/**
+ *
+ * @brief Return the index of the slot of a key, which must be in the table
+ */
+uint64_t
+htable_slot(htable*, const uint64_t*);
+
+/**
+ *
+ * @brief Return the value slot of a key, inserting the key if it is not in the table
+ */
+void**
+htable_insert(htable*, const uint64_t*, bool*);
+
+/**
+ *
+ * @brief Thread-safe version of htable_insert for fixed tables, the value of a new key must be set by htable_publish
+ */
+void**
+htable_claim(htable*, const uint64_t*, bool*);
+
+/**
+ * @brief Set the value of a key inserted by htable_claim, making it visible to other threads
+ */
+static inline void
+htable_publish(void** slot, void* value)
+{
+    __atomic_store_n(slot, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Return the key stored in the i-th slot of a table
+ */
+static inline uint64_t*
+htable_key_at(htable* t, uint64_t i)
+{
+    return &t->keys[i * t->key_words];
+}
+
+/**
+ * @brief Prefetch the slot a key is probed from, so that looking it up or inserting it soon after doesn't wait
+ *        for memory
+ */
+static inline void
+htable_prefetch(htable* t, const uint64_t* key)
+{
+    uint64_t i = hkmer_hash(key, t->key_words) & (t->capacity - 1);
+    __builtin_prefetch(&t->values[i]);
+    __builtin_prefetch(htable_key_at(t, i));
+}
+
+#endif
@@ -0,0 +1,727 @@
+#include "hunitig.h"
+
+/**
+ * Initial number of characters of the sequences of a list
+ */
+#define HUNITIG_LIST_CAPACITY 4096
+
+/**
+ *  Return true if v is inside a unitig, i.e. it has a single predecessor and a single successor and the edges
+ *  to them have been added the same number of times
+ */
+static inline bool
+is_internal(hgraph_vertex* v)
+{
+    bool single = __builtin_popcount(v->successors) == 1 && __builtin_popcount(v->predecessors) == 1;
+
+    return single && hgraph_vertex_outdegree(v) == hgraph_vertex_indegree(v);
+}
+
+/**
+ *  Flag the vertex in the given slot of shard s of the graph compacted by c as walked. Walks of several threads
+ *  flag vertices sharing a word of the bitmap
+ */
+static inline void
+mark_visited(hunitig_compactor* c, uint64_t s, uint64_t slot)
+{
+    __atomic_fetch_or(&c->visited[s][slot >> 6], (uint64_t) 1 << (slot & 63), __ATOMIC_RELAXED);
+}
+
+/**
+ *  Return true if the vertex in the given slot of shard s of the graph compacted by c has been walked
+ */
+static inline bool
+is_visited(hunitig_compactor* c, uint64_t s, uint64_t slot)
+{
+    return (c->visited[s][slot >> 6] >> (slot & 63)) & 1;
+}
+
+/**
+ *  Make room for one more unitig in list
+ */
+static void
+reserve_unitig(hunitig_list* list)
+{
+    if (list->count_unitigs == list->capacity_unitigs)
+    {
+        list->capacity_unitigs = list->capacity_unitigs == 0 ? 16 : 2 * list->capacity_unitigs;
+        list->unitigs = realloc(list->unitigs, list->capacity_unitigs * sizeof(hunitig));
+        assert(list->unitigs != NULL && "Could not allocate unitigs");
+    }
+}
+
+/**
+ *  Make room for length more characters in the sequences of list
+ */
+static void
+reserve_sequences(hunitig_list* list, uint64_t length)
+{
+    if (list->length + length <= list->capacity)
+    {
+        return;
+    }
+
+    while (list->length + length > list->capacity)
+    {
+        list->capacity = list->capacity == 0 ? HUNITIG_LIST_CAPACITY : 2 * list->capacity;
+    }
+    list->sequences = realloc(list->sequences, list->capacity);
+    assert(list->sequences != NULL && "Could not allocate unitig sequences");
+}
+
+/**
+ *  Append to list the unitig of the graph compacted by c starting from the vertex v stored as key through base.
+ *  The key of the last vertex of the unitig, which is v itself when the unitig is a cycle, is written to end_key,
+ *  and every vertex walked through is flagged as visited
+ */
+static void
+walk_unitig(hunitig_compactor* c, hunitig_list* list, const uint64_t* key, hgraph_vertex* v, uint8_t base,
+            uint64_t* end_key)
+{
+    hgraph* g = c->g;
+    uint64_t key_length = g->k - 1;
+
+    // hkmer_decode writes a terminator, which is overwritten by the first base
+    reserve_unitig(list);
+    reserve_sequences(list, key_length + 1);
+    hunitig* unitig = &list->unitigs[list->count_unitigs++];
+    unitig->offset = list->length;
+    unitig->multiplicity = v->out_multiplicity[base];
+    hkmer_decode(key, key_length, &list->sequences[list->length]);
+    list->length += key_length;
+
+    memcpy(end_key, key, g->key_words * sizeof(uint64_t));
+    hgraph_vertex* u = v;
+
+    for (;;)
+    {
+        reserve_sequences(list, 1);
+        list->sequences[list->length++] = hkmer_decode_base(base);
+        hkmer_push_back(end_key, key_length, base);
+
+        u = u->next[base];
+        if (u == v || !is_internal(u))
+        {
+            break;
+        }
+
+        uint64_t t = hgraph_shard_index(g, end_key);
+        mark_visited(c, t, htable_slot(g->shards[t].vertices, end_key));
+        base = __builtin_ctz(u->successors);
+    }
+
+    unitig->length = list->length - unitig->offset;
+}
+
+/**
+ *  Number the nodes of the shards of worker w, in the order of their slots, and allocate the visited flags of
+ *  their slots
+ */
+static void*
+number_nodes(void* arg)
+{
+    hunitig_worker* w = arg;
+    hunitig_compactor* c = w->compactor;
+    hgraph* g = c->g;
+
+    for (uint64_t s = w->id; s < g->count_shards; s += c->count_workers)
+    {
+        htable* vertices = g->shards[s].vertices;
+        uint64_t* ids = malloc(vertices->capacity * sizeof(uint64_t) + 1);
+        c->visited[s] = calloc((vertices->capacity + 63) / 64 + 1, sizeof(uint64_t));
+        assert(ids != NULL && c->visited[s] != NULL && "Could not allocate unitig node numbers");
+        uint64_t count_nodes = 0;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v != NULL && !is_internal(v))
+            {
+                ids[i] = count_nodes++;
+            }
+        }
+
+        c->node_ids[s] = ids;
+
+        c->first_node[s + 1] = count_nodes;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Walk the unitigs starting from the nodes of the shards of worker w, in the order of the nodes
+ */
+static void*
+walk_shards(void* arg)
+{
+    hunitig_worker* w = arg;
+    hunitig_compactor* c = w->compactor;
+    hgraph* g = c->g;
+    uint64_t key_size = g->key_words * sizeof(uint64_t);
+
+    for (uint64_t s = w->id; s < g->count_shards; s += c->count_workers)
+    {
+        htable* vertices = g->shards[s].vertices;
+        hunitig_list* list = &c->lists[s];
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v == NULL || is_internal(v))
+            {
+                continue;
+            }
+
+            const uint64_t* key = htable_key_at(vertices, i);
+            memcpy(&c->keys[(c->first_node[s] + c->node_ids[s][i]) * g->key_words], key, key_size);
+
+            for (uint8_t base = 0; base < 4; base++)
+            {
+                if (hgraph_vertex_has_successor(v, base))
+                {
+                    walk_unitig(c, list, key, v, base, w->key);
+                    uint64_t t = hgraph_shard_index(g, w->key);
+                    list->unitigs[list->count_unitigs - 1].end
+                        = c->first_node[t] + c->node_ids[t][htable_slot(g->shards[t].vertices, w->key)];
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Run fn on every worker of c, worker 0 on the calling thread, and wait for all of them
+ */
+static void
+run_workers(hunitig_compactor* c, void* (*fn)(void*))
+{
+    for (uint64_t i = 1; i < c->count_workers; i++)
+    {
+        int error = pthread_create(&c->workers[i].thread, NULL, fn, &c->workers[i]);
+        assert(error == 0 && "Could not create compaction thread");
+    }
+
+    fn(&c->workers[0]);
+
+    for (uint64_t i = 1; i < c->count_workers; i++)
+    {
+        pthread_join(c->workers[i].thread, NULL);
+    }
+}
+
+/**
+ *  Append to the nodes of c a node for each cycle of g whose vertices are all inside a unitig, and the unitig
+ *  of the cycle to list. Return the new number of nodes
+ */
+static uint64_t
+add_cycles(hunitig_compactor* c, hunitig_list* list, uint64_t count_nodes)
+{
+    hgraph* g = c->g;
+    uint64_t key_size = g->key_words * sizeof(uint64_t);
+    uint64_t capacity = count_nodes;
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v == NULL || !is_internal(v) || is_visited(c, s, i))
+            {
+                continue;
+            }
+
+            if (count_nodes == capacity)
+            {
+                capacity = capacity == 0 ? 16 : 2 * capacity;
+                c->keys = realloc(c->keys, capacity * key_size);
+                assert(c->keys != NULL && "Could not allocate unitig nodes");
+            }
+
+            const uint64_t* key = htable_key_at(vertices, i);
+            memcpy(&c->keys[count_nodes * g->key_words], key, key_size);
+
+            mark_visited(c, s, i);
+            walk_unitig(c, list, key, v, __builtin_ctz(v->successors), c->workers[0].key);
+            list->unitigs[list->count_unitigs - 1].end = count_nodes++;
+        }
+    }
+
+    return count_nodes;
+}
+
+/**
+ *  Move the unitigs of the lists of c, then the unitigs of cycles, to the compacted graph u whose nodes have
+ *  been counted
+ */
+static void
+merge_lists(hunitig_compactor* c, hunitig_list* cycles, hunitig_graph* u)
+{
+    uint64_t count_lists = c->g->count_shards + 1;
+    uint64_t count_unitigs = 0;
+    uint64_t length = 0;
+
+    for (uint64_t s = 0; s < count_lists; s++)
+    {
+        hunitig_list* list = s < c->g->count_shards ? &c->lists[s] : cycles;
+        count_unitigs += list->count_unitigs;
+        length += list->length;
+    }
+
+    u->count_unitigs = count_unitigs;
+    u->unitigs = malloc(count_unitigs * sizeof(hunitig) + 1);
+    u->sequences = malloc(length + 1);
+    u->first_unitig = calloc(u->count_nodes + 1, sizeof(uint64_t));
+    assert(u->unitigs != NULL && u->sequences != NULL && u->first_unitig != NULL && "Could not allocate unitigs");
+
+    uint64_t unitig = 0;
+    uint64_t offset = 0;
+
+    for (uint64_t s = 0; s < count_lists; s++)
+    {
+        hunitig_list* list = s < c->g->count_shards ? &c->lists[s] : cycles;
+
+        for (uint64_t i = 0; i < list->count_unitigs; i++)
+        {
+            u->unitigs[unitig] = list->unitigs[i];
+            u->unitigs[unitig].offset += offset;
+            unitig++;
+        }
+
+        if (list->length > 0)
+        {
+            memcpy(&u->sequences[offset], list->sequences, list->length);
+            offset += list->length;
+        }
+
+        free(list->unitigs);
+        free(list->sequences);
+    }
+}
+
+/**
+ *  Set the index of the first unitig of each node of u from the number of unitigs starting from each node of g,
+ *  the nodes of cycles having one unitig each
+ */
+static void
+index_unitigs(hunitig_compactor* c, hunitig_graph* u)
+{
+    hgraph* g = c->g;
+    uint64_t node = 0;
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        htable* vertices = g->shards[s].vertices;
+
+        for (uint64_t i = 0; i < vertices->capacity; i++)
+        {
+            hgraph_vertex* v = vertices->values[i];
+            if (v != NULL && !is_internal(v))
+            {
+                u->first_unitig[node + 1] = __builtin_popcount(v->successors);
+                node++;
+            }
+        }
+    }
+
+    for (; node < u->count_nodes; node++)
+    {
+        u->first_unitig[node + 1] = 1;
+    }
+
+    for (node = 0; node < u->count_nodes; node++)
+    {
+        u->first_unitig[node + 1] += u->first_unitig[node];
+    }
+}
+
+/**
+ * @param g An hague graph of the forward strand, whose successors are linked
+ * @param threads Number of threads compacting the shards of g, must be greater than 0
+ * @return The compacted graph of g, which is left unchanged except for the number of followed edges of its
+ *         vertices
+ *
+ * Every edge of g belongs to exactly one unitig, so an eulerian walk of the compacted graph spells an eulerian
+ * walk of g. Shards are compacted by up to threads threads, see hunitig_compactor
+ */
+hunitig_graph*
+hunitig_compact(hgraph* g, uint64_t threads)
+{
+    assert(g != NULL && "Graph is not initialized");
+    assert(!g->canonical && "Unitigs need a graph of the forward strand");
+    assert(threads > 0 && "Number of threads must be greater than 0");
+
+    hunitig_compactor c;
+    c.g = g;
+    c.count_workers = threads < g->count_shards ? threads : g->count_shards;
+    c.workers = malloc(c.count_workers * sizeof(hunitig_worker));
+    c.first_node = calloc(g->count_shards + 1, sizeof(uint64_t));
+    c.node_ids = malloc(g->count_shards * sizeof(uint64_t*));
+    c.visited = malloc(g->count_shards * sizeof(uint64_t*));
+    c.lists = calloc(g->count_shards, sizeof(hunitig_list));
+    assert(c.workers != NULL && c.first_node != NULL && c.node_ids != NULL && c.visited != NULL && c.lists != NULL
+           && "Could not allocate compaction");
+
+    for (uint64_t i = 0; i < c.count_workers; i++)
+    {
+        c.workers[i].compactor = &c;
+        c.workers[i].id = i;
+        c.workers[i].key = malloc(g->key_words * sizeof(uint64_t));
+    }
+
+    run_workers(&c, number_nodes);
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        c.first_node[s + 1] += c.first_node[s];
+    }
+
+    uint64_t count_nodes = c.first_node[g->count_shards];
+    c.keys = malloc(count_nodes * g->key_words * sizeof(uint64_t) + 1);
+    assert(c.keys != NULL && "Could not allocate unitig nodes");
+
+    run_workers(&c, walk_shards);
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        free(c.node_ids[s]);
+    }
+    free(c.node_ids);
+
+    hunitig_list cycles;
+    memset(&cycles, 0, sizeof(hunitig_list));
+
+    hunitig_graph* u = malloc(sizeof(hunitig_graph));
+    u->k = g->k;
+    u->key_words = g->key_words;
+    u->count_nodes = add_cycles(&c, &cycles, count_nodes);
+    u->keys = c.keys;
+
+    for (uint64_t s = 0; s < g->count_shards; s++)
+    {
+        free(c.visited[s]);
+    }
+    free(c.visited);
+
+    merge_lists(&c, &cycles, u);
+    index_unitigs(&c, u);
+
+    for (uint64_t i = 0; i < c.count_workers; i++)
+    {
+        free(c.workers[i].key);
+    }
+    free(c.workers);
+    free(c.first_node);
+    free(c.lists);
+
+    return u;
+}
+
+/**
+ * @param u A compacted graph
+ */
+void
+hunitig_destroy(hunitig_graph* u)
+{
+    assert(u != NULL && "Compacted graph is not initialized");
+
+    free(u->keys);
+    free(u->first_unitig);
+    free(u->unitigs);
+    free(u->sequences);
+    free(u);
+}
+
+/**
+ * @param u A compacted graph
+ * @return The number of k-mers of the unitigs of u, counted once for each time they have been added
+ */
+uint64_t
+hunitig_edge_count(hunitig_graph* u)
+{
+    uint64_t count_edges = 0;
+
+    for (uint64_t i = 0; i < u->count_unitigs; i++)
+    {
+        count_edges += (u->unitigs[i].length - (u->k - 1)) * u->unitigs[i].multiplicity;
+    }
+
+    return count_edges;
+}
+
+/**
+ *  Return the index of the unitig to follow next from node of u, whose first followed unitigs are counted in
+ *  followed, UINT64_MAX if every unitig has been followed as many times as its multiplicity. Unitigs are followed
+ *  in the order of their second base, like the edges of a walk of hgraph
+ */
+static uint64_t
+next_walk_unitig(hunitig_graph* u, uint64_t node, const uint64_t* followed)
+{
+    uint64_t j = followed[node];
+
+    for (uint64_t i = u->first_unitig[node]; i < u->first_unitig[node + 1]; i++)
+    {
+        if (j < u->unitigs[i].multiplicity)
+        {
+            return i;
+        }
+        j -= u->unitigs[i].multiplicity;
+    }
+
+    return UINT64_MAX;
+}
+
+/**
+ *  Return the node an eulerian walk of u starts from, UINT64_MAX if there is no eulerian path or cycle. As in
+ *  hgraph, a cycle starts from the first node
+ */
+static uint64_t
+walk_start(hunitig_graph* u)
+{
+    int64_t* balance = calloc(u->count_nodes + 1, sizeof(int64_t));
+    assert(balance != NULL && "Could not allocate eulerian walk");
+
+    for (uint64_t node = 0; node < u->count_nodes; node++)
+    {
+        for (uint64_t i = u->first_unitig[node]; i < u->first_unitig[node + 1]; i++)
+        {
+            balance[node] += u->unitigs[i].multiplicity;
+            balance[u->unitigs[i].end] -= u->unitigs[i].multiplicity;
+        }
+    }
+
+    uint64_t start = u->count_nodes > 0 ? 0 : UINT64_MAX;
+    uint64_t count_starts = 0;
+    uint64_t count_ends = 0;
+    uint64_t count_generic = 0;
+
+    for (uint64_t node = 0; node < u->count_nodes; node++)
+    {
+        if (balance[node] == 1)
+        {
+            start = node;
+            count_starts++;
+        }
+        else if (balance[node] == -1)
+        {
+            count_ends++;
+        }
+        else if (balance[node] != 0)
+        {
+            count_generic++;
+        }
+    }
+
+    free(balance);
+
+    bool eulerian = count_generic == 0 && count_starts == count_ends && count_starts <= 1;
+
+    return eulerian ? start : UINT64_MAX;
+}
+
+/**
+ *  Successor accessor of the walker of a compacted graph. A step is the index of the unitig used to reach a node
+ *  plus 1, 0 for the starting node
+ */
+static uint64_t
+walk_successor(void* graph, uint64_t step)
+{
+    hunitig_walk* walk = graph;
+    hunitig_graph* u = walk->u;
+    uint64_t node = step == 0 ? walk->start : u->unitigs[step - 1].end;
+    uint64_t next = next_walk_unitig(u, node, walk->followed);
+
+    if (next == UINT64_MAX)
+    {
+        return HGRAPH_WALK_NONE;
+    }
+
+    walk->followed[node]++;
+
+    return next + 1;
+}
+
+/**
+ *  Label accessor of the walker of a compacted graph, a unitig appends its sequence after its starting key
+ */
+static const char*
+walk_label(void* graph, uint64_t step, uint64_t* length)
+{
+    hunitig_walk* walk = graph;
+    hunitig_graph* u = walk->u;
+    hunitig* unitig = &u->unitigs[step - 1];
+    *length = unitig->length - (u->k - 1);
+
+    return &u->sequences[unitig->offset + u->k - 1];
+}
+
+/**
+ *  Set w to walk u from the starting node of its eulerian walk, counting the followed unitigs in walk, whose
+ *  array is allocated here. Return false if u has no eulerian path or cycle, in which case nothing is allocated
+ */
+static bool
+init_walker(hunitig_graph* u, hunitig_walk* walk, hgraph_walker* w)
+{
+    uint64_t start = walk_start(u);
+    if (start == UINT64_MAX)
+    {
+        return false;
+    }
+
+    walk->u = u;
+    walk->start = start;
+    walk->followed = calloc(u->count_nodes, sizeof(uint64_t));
+    assert(walk->followed != NULL && "Could not allocate eulerian walk");
+
+    uint64_t count_walked = 0;
+    for (uint64_t i = 0; i < u->count_unitigs; i++)
+    {
+        count_walked += u->unitigs[i].multiplicity;
+    }
+
+    w->graph = walk;
+    w->successor = walk_successor;
+    w->label = walk_label;
+    w->start = 0;
+    w->start_key = &u->keys[start * u->key_words];
+    w->key_length = u->k - 1;
+    w->count_steps = count_walked;
+    w->length = hunitig_edge_count(u) + w->key_length;
+
+    return true;
+}
+
+/**
+ * @param u A compacted graph
+ * @return A string containing the concatenation of edge labels, from eulerian walk starting node to ending node,
+ *         NULL if the edges of u can't be covered by a single walk
+ *
+ * The walk is computed by hgraph_walk over the unitigs, like hgraph_compute_eulerian_walk over the edges, and
+ * spells the same string as the walk of the graph u has been compacted from when it is a path.
+ */
+char*
+hunitig_compute_eulerian_walk(hunitig_graph* u)
+{
+    assert(u != NULL && "Compacted graph is not initialized");
+
+    hunitig_walk walk;
+    hgraph_walker w;
+    if (!init_walker(u, &walk, &w))
+    {
+        return NULL;
+    }
+
+    char* result = hgraph_walk_string(&w);
+    free(walk.followed);
+
+    return result;
+}
+
+/**
+ * @param u A compacted graph
+ * @param fd Descriptor of the output file, the console or a pipe
+ * @return True if the walk has been written, false if the edges of u can't be covered by a single walk
+ *
+ * The walk is computed like hunitig_compute_eulerian_walk and written like hgraph_export_eulerian_walk, so memory
+ * doesn't depend on its length, even for unitigs longer than a chunk. Nothing is written if there is no walk
+ */
+bool
+hunitig_export_eulerian_walk(hunitig_graph* u, int fd)
+{
+    assert(u != NULL && "Compacted graph is not initialized");
+
+    hunitig_walk walk;
+    hgraph_walker w;
+    if (!init_walker(u, &walk, &w))
+    {
+        return false;
+    }
+
+    bool connected = hgraph_walk_export(&w, fd);
+    free(walk.followed);
+
+    return connected;
+}
+
+/**
+ *  Write the unitigs of u to o using Gephi "Edges table" notation, labelled with their sequences. If weighted,
+ *  each unitig is written once with its multiplicity as weight
+ */
+static void
+write_unitigs_table(hunitig_graph* u, output* o, bool weighted)
+{
+    uint64_t key_length = u->k - 1;
+
+    // Sources and targets are decoded with their separator, labels are written from the sequences in place
+    char* source = malloc(key_length + 2);
+    char* target = malloc(key_length + 2);
+
+    const char* header = weighted ? "Source, Target, Label, Weight\n" : "Source, Target, Label\n";
+    output_write(o, header, strlen(header));
+
+    for (uint64_t node = 0; node < u->count_nodes; node++)
+    {
+        hkmer_decode(&u->keys[node * u->key_words], key_length, source);
+        memcpy(&source[key_length], ", ", 2);
+
+        for (uint64_t i = u->first_unitig[node]; i < u->first_unitig[node + 1]; i++)
+        {
+            hunitig* unitig = &u->unitigs[i];
+            const char* label = &u->sequences[unitig->offset];
+            hkmer_decode(&u->keys[unitig->end * u->key_words], key_length, target);
+            memcpy(&target[key_length], ", ", 2);
+
+            // A unitig added several times is written once for each time
+            uint32_t count = weighted ? 1 : unitig->multiplicity;
+            for (uint32_t j = 0; j < count; j++)
+            {
+                output_write(o, source, key_length + 2);
+                output_write(o, target, key_length + 2);
+                output_write(o, label, unitig->length);
+
+                if (weighted)
+                {
+                    output_write(o, ", ", 2);
+                    output_uint(o, unitig->multiplicity);
+                }
+                output_char(o, '\n');
+            }
+        }
+    }
+
+    free(source);
+    free(target);
+}
+
+/**
+ * @param u A compacted graph
+ * @param filename Name of the output file
+ * @param weighted True to write each unitig once with the number of times its k-mers have been added
+ */
+void
+hunitig_export_to_file(hunitig_graph* u, char* filename, bool weighted)
+{
+    assert(u != NULL && "Compacted graph is not initialized");
+    output* o = output_open(filename);
+    write_unitigs_table(u, o, weighted);
+
+    output_close(o);
+}
+
+/**
+ * @param u A compacted graph
+ * @param weighted True to write each unitig once with the number of times its k-mers have been added
+ */
+void
+hunitig_print_graph(hunitig_graph* u, bool weighted)
+{
+    assert(u != NULL && "Compacted graph is not initialized");
+    output* o = output_open_stdout();
+    write_unitigs_table(u, o, weighted);
+
+    output_close(o);
+}
@@ -0,0 +1,166 @@
+#ifndef HAGUE_UNITIG_H
+#define HAGUE_UNITIG_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "graph/hkmer.h"
+#include "graph/htable.h"
+#include "graph/hgraph.h"
+
+typedef struct hunitig hunitig;
+
+typedef struct hunitig_graph hunitig_graph;
+
+typedef struct hunitig_list hunitig_list;
+
+typedef struct hunitig_compactor hunitig_compactor;
+
+typedef struct hunitig_worker hunitig_worker;
+
+typedef struct hunitig_walk hunitig_walk;
+
+/** @struct hunitig
+    @brief A maximal non-branching path of an "Hague Graph", stored as a single edge
+
+    The sequence of a unitig is the key of its starting node followed by the last base of each of its k-mers.
+    Every k-mer of a unitig has been added the same number of times, which is the multiplicity of the unitig.
+*/
+struct hunitig
+{
+    uint64_t end; /**< Index of the node the unitig ends at */
+    uint64_t offset; /**< Offset of the sequence of the unitig in the sequences of its graph */
+    uint64_t length; /**< Number of characters of the sequence, i.e. k - 1 plus the number of k-mers */
+    uint32_t multiplicity; /**< Number of times each k-mer of the unitig has been added */
+};
+
+/** @struct hunitig_graph
+    @brief A compacted De Bruijn graph, whose edges are the unitigs of an "Hague Graph"
+
+    Nodes are the vertices of the hague graph which don't have exactly one incoming and one outgoing edge added
+    the same number of times, plus one vertex of each cycle made of such vertices only. Both nodes and unitigs
+    are stored in arrays: the unitigs starting from node i are unitigs[first_unitig[i]] to
+    unitigs[first_unitig[i + 1] - 1], ordered by their second base.
+*/
+struct hunitig_graph
+{
+    uint64_t k; /**< Length of the k-mers, node keys are (k-1)-mers */
+    uint64_t key_words; /**< Number of words of a packed node key */
+    uint64_t count_nodes; /**< Number of nodes */
+    uint64_t* keys; /**< Packed keys of the nodes, key_words words for each node */
+    uint64_t* first_unitig; /**< Index of the first unitig starting from each node, count_nodes + 1 entries */
+    uint64_t count_unitigs; /**< Number of unitigs */
+    hunitig* unitigs; /**< Unitigs, grouped by starting node */
+    char* sequences; /**< Sequences of the unitigs, not null terminated */
+};
+
+/** @struct hunitig_list
+    @brief Growable arrays of the unitigs starting from the nodes of a shard, and of their sequences
+*/
+struct hunitig_list
+{
+    hunitig* unitigs; /**< Unitigs, whose offsets are relative to the sequences of the list */
+    uint64_t count_unitigs; /**< Number of unitigs */
+    uint64_t capacity_unitigs; /**< Number of allocated unitigs */
+    char* sequences; /**< Sequences of the unitigs */
+    uint64_t length; /**< Number of used characters */
+    uint64_t capacity; /**< Number of allocated characters */
+};
+
+/** @struct hunitig_worker
+    @brief A thread compacting some of the shards of an "Hague Graph"
+*/
+struct hunitig_worker
+{
+    hunitig_compactor* compactor; /**< Compaction the worker belongs to */
+    uint64_t id; /**< Index of the worker, which compacts the shards whose index is id modulo the workers */
+    pthread_t thread; /**< Thread running the worker, unused for worker 0 which runs on the calling thread */
+    uint64_t* key; /**< Scratch buffer of a key, the end of the unitig being walked */
+};
+
+/** @struct hunitig_compactor
+    @brief Parallel compaction of the unitigs of a sharded "Hague Graph"
+
+    Compaction runs in two passes over the shards. The first one numbers the nodes of each shard, the second one
+    walks the unitigs starting from the nodes of each shard. The vertices of a unitig belong to any shard, but
+    each one is only visited by the walk of its unitig, so no lock is needed. The number of a node and the visited
+    flag of the other vertices are stored in arrays of their shard indexed by slot, so the vertices are left
+    unchanged, and a vertex reached by a walk is found from its key. Cycles without any node are left to the
+    calling thread.
+*/
+struct hunitig_compactor
+{
+    hgraph* g; /**< Graph being compacted */
+    uint64_t count_workers; /**< Number of workers */
+    hunitig_worker* workers; /**< Workers */
+    uint64_t* first_node; /**< Index of the first node of each shard, count_shards + 1 entries */
+    uint64_t** node_ids; /**< Index of the node of each slot of each shard among the nodes of the shard */
+    uint64_t** visited; /**< Bitmap of the slots of each shard whose vertex has been walked through */
+    hunitig_list* lists; /**< Unitigs starting from the nodes of each shard */
+    uint64_t* keys; /**< Packed keys of the nodes */
+};
+
+/** @struct hunitig_walk
+    @brief Graph given to the accessors of the walker of a compacted graph, whose edges are its unitigs
+*/
+struct hunitig_walk
+{
+    hunitig_graph* u; /**< Compacted graph being walked */
+    uint64_t start; /**< Node the walk starts from */
+    uint64_t* followed; /**< Number of times the unitigs of each node have been followed */
+};
+
+/**
+ *
+ * @brief Compact the non-branching paths of an hague graph of the forward strand with a given number of threads
+ */
+hunitig_graph*
+hunitig_compact(hgraph*, uint64_t);
+
+/**
+ *
+ * @brief Free the memory of a compacted graph
+ */
+void
+hunitig_destroy(hunitig_graph*);
+
+/**
+ *
+ * @brief Return the number of edges of the hague graph a compacted graph has been built from
+ */
+uint64_t
+hunitig_edge_count(hunitig_graph*);
+
+/**
+ *
+ * @brief Return the concatenation of the labels of an eulerian walk of a compacted graph, NULL if there is none
+ */
+char*
+hunitig_compute_eulerian_walk(hunitig_graph*);
+
+/**
+ *
+ * @brief Write an eulerian walk of a compacted graph to a file descriptor while it is computed, false if there is none
+ */
+bool
+hunitig_export_eulerian_walk(hunitig_graph*, int);
+
+/**
+ *
+ * @brief Export the unitigs of a compacted graph to a file, with their multiplicities as weights if requested
+ */
+void
+hunitig_export_to_file(hunitig_graph*, char*, bool);
+
+/**
+ *
+ * @brief Print the unitigs of a compacted graph, with their multiplicities as weights if requested
+ */
+void
+hunitig_print_graph(hunitig_graph*, bool);
+
+#endif
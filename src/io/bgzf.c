@@ -0,0 +1,322 @@
+#include "bgzf.h"
+
+/**
+ * Size of the fixed part of a gzip header, up to the length of the extra field
+ */
+#define BGZF_HEADER_SIZE 12
+
+/**
+ * Size of a gzip trailer, i.e. CRC32 and size of the inflated data
+ */
+#define BGZF_TRAILER_SIZE 8
+
+/**
+ * Number of slots of the ring for each worker
+ */
+#define BGZF_SLOTS_PER_WORKER 4
+
+/**
+ *  Return the little endian 16 bits number at p
+ */
+static inline uint32_t
+read_le16(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8);
+}
+
+/**
+ *  Return the little endian 32 bits number at p
+ */
+static inline uint32_t
+read_le32(const uint8_t* p)
+{
+    return read_le16(p) | (read_le16(p + 2) << 16);
+}
+
+/**
+ *  Return the size of the block whose header, extra field included, is at h, 0 if it is not a BGZF block
+ */
+static uint64_t
+block_size(const uint8_t* h)
+{
+    // gzip magic, deflate method and FEXTRA as the only flag
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || h[3] != 4)
+    {
+        return 0;
+    }
+
+    uint64_t xlen = read_le16(&h[10]);
+    const uint8_t* extra = &h[BGZF_HEADER_SIZE];
+
+    // Look for the "BC" subfield, which holds the size of the block minus 1
+    for (uint64_t i = 0; i + 4 <= xlen; i += 4 + read_le16(&extra[i + 2]))
+    {
+        if (extra[i] == 'B' && extra[i + 1] == 'C' && read_le16(&extra[i + 2]) == 2 && i + 6 <= xlen)
+        {
+            return read_le16(&extra[i + 4]) + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @param filename Name of a file
+ * @return True if the file starts with a BGZF block, false if it is plain gzip, uncompressed or unreadable
+ */
+bool
+bgzf_detect(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+
+    uint8_t h[BGZF_HEADER_SIZE + UINT16_MAX];
+    bool detected = false;
+
+    if (fread(h, 1, BGZF_HEADER_SIZE, f) == BGZF_HEADER_SIZE)
+    {
+        uint64_t xlen = read_le16(&h[10]);
+        detected = fread(&h[BGZF_HEADER_SIZE], 1, xlen, f) == xlen && block_size(h) > 0;
+    }
+
+    fclose(f);
+
+    return detected;
+}
+
+/**
+ *  Read the next block of BGZF file z into slot, return false at the end of the file. Must hold the lock of z
+ */
+static bool
+read_block(bgzf* z, bgzf_block* slot)
+{
+    uint8_t* c = slot->compressed;
+
+    uint64_t n = fread(c, 1, BGZF_HEADER_SIZE, z->file);
+    if (n == 0)
+    {
+        return false;
+    }
+
+    uint64_t xlen = read_le16(&c[10]);
+    assert(n == BGZF_HEADER_SIZE && BGZF_HEADER_SIZE + xlen <= BGZF_MAX_BLOCK_SIZE && "Truncated BGZF block");
+    n += fread(&c[BGZF_HEADER_SIZE], 1, xlen, z->file);
+
+    uint64_t size = block_size(c);
+    assert(n == BGZF_HEADER_SIZE + xlen && size >= n + BGZF_TRAILER_SIZE && "Invalid BGZF block");
+    n += fread(&c[n], 1, size - n, z->file);
+    assert(n == size && "Truncated BGZF block");
+
+    slot->compressed_length = size;
+
+    return true;
+}
+
+/**
+ *  Inflate the compressed block of slot with s, a raw inflate stream, and check its CRC
+ */
+static void
+inflate_block(z_stream* s, bgzf_block* slot)
+{
+    uint8_t* c = slot->compressed;
+    uint64_t header = BGZF_HEADER_SIZE + read_le16(&c[10]);
+    uint64_t trailer = slot->compressed_length - BGZF_TRAILER_SIZE;
+
+    inflateReset(s);
+    s->next_in = &c[header];
+    s->avail_in = trailer - header;
+    s->next_out = (Bytef*) slot->data;
+    s->avail_out = BGZF_MAX_BLOCK_SIZE;
+
+    int result = inflate(s, Z_FINISH);
+    assert(result == Z_STREAM_END && "Corrupted BGZF block");
+
+    slot->length = BGZF_MAX_BLOCK_SIZE - s->avail_out;
+    assert(slot->length == read_le32(&c[trailer + 4]) && "Corrupted BGZF block");
+    assert(crc32(0, (Bytef*) slot->data, slot->length) == read_le32(&c[trailer]) && "Corrupted BGZF block");
+}
+
+/**
+ *  Body of the inflating threads, which read and inflate blocks until the end of the file
+ */
+static void*
+run_worker(void* arg)
+{
+    bgzf* z = arg;
+
+    z_stream s;
+    memset(&s, 0, sizeof(z_stream));
+    int result = inflateInit2(&s, -15);
+    assert(result == Z_OK && "Could not initialize inflate stream");
+
+    pthread_mutex_lock(&z->lock);
+    for (;;)
+    {
+        // Wait for the slot of the next block to be consumed
+        while (!z->stop && z->count_blocks == UINT64_MAX && z->count_read - z->count_consumed == z->count_slots)
+        {
+            pthread_cond_wait(&z->consumed, &z->lock);
+        }
+
+        if (z->stop || z->count_blocks != UINT64_MAX)
+        {
+            break;
+        }
+
+        bgzf_block* slot = &z->slots[z->count_read % z->count_slots];
+        if (!read_block(z, slot))
+        {
+            z->count_blocks = z->count_read;
+            pthread_cond_broadcast(&z->inflated);
+            break;
+        }
+        z->count_read++;
+        pthread_mutex_unlock(&z->lock);
+
+        inflate_block(&s, slot);
+
+        pthread_mutex_lock(&z->lock);
+        slot->ready = true;
+        pthread_cond_broadcast(&z->inflated);
+    }
+    pthread_mutex_unlock(&z->lock);
+
+    inflateEnd(&s);
+
+    return NULL;
+}
+
+/**
+ * @param filename Name of a BGZF file
+ * @param threads Number of inflating threads, must be greater than 0
+ * @return The opened file, whose threads are already inflating the first blocks
+ */
+bgzf*
+bgzf_open(const char* filename, uint64_t threads)
+{
+    assert(threads > 0 && "Number of threads must be greater than 0");
+
+    bgzf* z = malloc(sizeof(bgzf));
+    z->file = fopen(filename, "rb");
+    assert(z->file != NULL && "Could not open BGZF file");
+
+    z->count_workers = threads;
+    z->workers = malloc(threads * sizeof(pthread_t));
+    z->count_slots = threads * BGZF_SLOTS_PER_WORKER;
+    z->slots = malloc(z->count_slots * sizeof(bgzf_block));
+    z->count_read = 0;
+    z->count_consumed = 0;
+    z->offset = 0;
+    z->count_blocks = UINT64_MAX;
+    z->stop = false;
+
+    for (uint64_t i = 0; i < z->count_slots; i++)
+    {
+        z->slots[i].compressed = malloc(BGZF_MAX_BLOCK_SIZE);
+        z->slots[i].data = malloc(BGZF_MAX_BLOCK_SIZE);
+        z->slots[i].ready = false;
+        assert(z->slots[i].compressed != NULL && z->slots[i].data != NULL && "Could not allocate BGZF block");
+    }
+
+    pthread_mutex_init(&z->lock, NULL);
+    pthread_cond_init(&z->inflated, NULL);
+    pthread_cond_init(&z->consumed, NULL);
+
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        int error = pthread_create(&z->workers[i], NULL, run_worker, z);
+        assert(error == 0 && "Could not create inflating thread");
+    }
+
+    return z;
+}
+
+/**
+ * @param z An opened BGZF file
+ * @param buffer Destination of the inflated bytes
+ * @param length Maximum number of bytes to read
+ * @return The number of bytes read, less than length only at the end of the file
+ */
+int
+bgzf_read(bgzf* z, void* buffer, unsigned length)
+{
+    char* out = buffer;
+    uint64_t copied = 0;
+
+    while (copied < length)
+    {
+        bgzf_block* slot = &z->slots[z->count_consumed % z->count_slots];
+
+        pthread_mutex_lock(&z->lock);
+        while (!slot->ready && z->count_consumed != z->count_blocks)
+        {
+            pthread_cond_wait(&z->inflated, &z->lock);
+        }
+        bool ready = slot->ready;
+        pthread_mutex_unlock(&z->lock);
+
+        // End of the file
+        if (!ready)
+        {
+            break;
+        }
+
+        uint64_t n = slot->length - z->offset;
+        if (n > length - copied)
+        {
+            n = length - copied;
+        }
+
+        memcpy(&out[copied], &slot->data[z->offset], n);
+        copied += n;
+        z->offset += n;
+
+        if (z->offset == slot->length)
+        {
+            pthread_mutex_lock(&z->lock);
+            slot->ready = false;
+            z->count_consumed++;
+            z->offset = 0;
+            pthread_cond_broadcast(&z->consumed);
+            pthread_mutex_unlock(&z->lock);
+        }
+    }
+
+    return copied;
+}
+
+/**
+ * @param z An opened BGZF file
+ */
+void
+bgzf_close(bgzf* z)
+{
+    assert(z != NULL && "BGZF file is not opened");
+
+    pthread_mutex_lock(&z->lock);
+    z->stop = true;
+    pthread_cond_broadcast(&z->consumed);
+    pthread_mutex_unlock(&z->lock);
+
+    for (uint64_t i = 0; i < z->count_workers; i++)
+    {
+        pthread_join(z->workers[i], NULL);
+    }
+
+    for (uint64_t i = 0; i < z->count_slots; i++)
+    {
+        free(z->slots[i].compressed);
+        free(z->slots[i].data);
+    }
+
+    pthread_mutex_destroy(&z->lock);
+    pthread_cond_destroy(&z->inflated);
+    pthread_cond_destroy(&z->consumed);
+    fclose(z->file);
+    free(z->slots);
+    free(z->workers);
+    free(z);
+}
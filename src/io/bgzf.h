@@ -0,0 +1,87 @@
+#ifndef HAGUE_BGZF_H
+#define HAGUE_BGZF_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <zlib.h>
+
+/**
+ * Maximum size of a BGZF block, compressed or not
+ */
+#define BGZF_MAX_BLOCK_SIZE 65536
+
+typedef struct bgzf bgzf;
+
+typedef struct bgzf_block bgzf_block;
+
+/** @struct bgzf_block
+    @brief A slot of the ring of blocks of a BGZF file being inflated
+*/
+struct bgzf_block
+{
+    uint8_t* compressed; /**< Compressed block, gzip header and trailer included */
+    uint64_t compressed_length; /**< Number of bytes of the compressed block */
+    char* data; /**< Inflated block */
+    uint64_t length; /**< Number of bytes of the inflated block */
+    bool ready; /**< True once the block has been inflated, until it is entirely consumed */
+};
+
+/** @struct bgzf
+    @brief A BGZF file inflated in parallel
+
+    A BGZF file (e.g. written by bgzip) is a sequence of gzip members of at most 64 KB, each one giving its own
+    compressed size in its header, so blocks can be found without inflating them. Worker threads take turns
+    reading the next block from the file, then inflate it independently into a ring of slots. Blocks are
+    consumed in file order: a worker waits before reading a block whose slot has not been consumed yet.
+*/
+struct bgzf
+{
+    FILE* file; /**< Compressed file, read by one worker at a time */
+    uint64_t count_workers; /**< Number of inflating threads */
+    pthread_t* workers; /**< Inflating threads */
+    uint64_t count_slots; /**< Number of slots of the ring */
+    bgzf_block* slots; /**< Ring of blocks, block i is stored in slot i modulo count_slots */
+    uint64_t count_read; /**< Number of blocks read from the file so far */
+    uint64_t count_consumed; /**< Number of blocks entirely consumed so far */
+    uint64_t offset; /**< Number of bytes of the current block already consumed */
+    uint64_t count_blocks; /**< Number of blocks of the file, UINT64_MAX until the end of the file is reached */
+    bool stop; /**< Set when the file is closed, to stop the workers */
+    pthread_mutex_t lock; /**< Protects the counters, the flags and the file */
+    pthread_cond_t inflated; /**< Signaled when a block has been inflated or the end of the file is reached */
+    pthread_cond_t consumed; /**< Signaled when a block has been consumed */
+};
+
+/**
+ *
+ * @brief Return true if and only if a file starts with a BGZF block
+ */
+bool
+bgzf_detect(const char*);
+
+/**
+ *
+ * @brief Open a BGZF file inflated by a given number of threads
+ */
+bgzf*
+bgzf_open(const char*, uint64_t);
+
+/**
+ *
+ * @brief Read inflated bytes from a BGZF file, return the number of bytes read, 0 at the end of the file
+ */
+int
+bgzf_read(bgzf*, void*, unsigned);
+
+/**
+ *
+ * @brief Stop the threads of a BGZF file and close it
+ */
+void
+bgzf_close(bgzf*);
+
+#endif
@@ -0,0 +1,115 @@
+#include "input.h"
+
+/**
+ * Typical compression ratio of gzip on sequences, used to estimate the length of compressed files
+ */
+#define INPUT_GZIP_RATIO 4
+
+/**
+ * @param filename Name of a file, gzip compressed or not
+ * @return True if the first uncompressed character of the file is '>', false if it is FASTQ, empty or unreadable
+ */
+bool
+fasta_input_detect(const char* filename)
+{
+    gzFile gz = gzopen(filename, "r");
+    if (gz == NULL)
+    {
+        return false;
+    }
+
+    bool detected = gzgetc(gz) == '>';
+    gzclose(gz);
+
+    return detected;
+}
+
+/**
+ * @param filename Name of a file, gzip compressed or not
+ * @return The length of the file, times INPUT_GZIP_RATIO if it is gzip compressed, 0 if it is unreadable
+ */
+uint64_t
+fasta_input_estimate_length(const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        return 0;
+    }
+
+    uint8_t magic[2] = { 0, 0 };
+    bool compressed = fread(magic, 1, 2, f) == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fclose(f);
+
+    if (length < 0)
+    {
+        return 0;
+    }
+
+    return compressed ? (uint64_t) length * INPUT_GZIP_RATIO : (uint64_t) length;
+}
+
+/**
+ * @param filename Name of a FASTA file, gzip compressed or not
+ * @param threads Number of threads inflating the file if it is BGZF, must be greater than 0
+ * @return The opened file
+ */
+fasta_input*
+fasta_input_open(const char* filename, uint64_t threads)
+{
+    fasta_input* in = malloc(sizeof(fasta_input));
+    in->gz = NULL;
+    in->bgzf = NULL;
+
+    if (bgzf_detect(filename))
+    {
+        in->bgzf = bgzf_open(filename, threads);
+    }
+    else
+    {
+        in->gz = gzopen(filename, "r");
+        assert(in->gz != NULL && "Could not open fasta file");
+    }
+
+    return in;
+}
+
+/**
+ * @param in An opened FASTA file
+ * @param buffer Destination of the uncompressed bytes
+ * @param length Maximum number of bytes to read
+ * @return The number of bytes read, 0 at the end of the file
+ */
+int
+fasta_input_read(fasta_input* in, void* buffer, unsigned length)
+{
+    if (in->bgzf != NULL)
+    {
+        return bgzf_read(in->bgzf, buffer, length);
+    }
+
+    return gzread(in->gz, buffer, length);
+}
+
+/**
+ * @param in An opened FASTA file
+ */
+void
+fasta_input_close(fasta_input* in)
+{
+    assert(in != NULL && "FASTA file is not opened");
+
+    if (in->bgzf != NULL)
+    {
+        bgzf_close(in->bgzf);
+    }
+    else
+    {
+        gzclose(in->gz);
+    }
+
+    free(in);
+}
@@ -0,0 +1,62 @@
+#ifndef HAGUE_INPUT_H
+#define HAGUE_INPUT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <zlib.h>
+#include "io/bgzf.h"
+
+typedef struct fasta_input fasta_input;
+
+/** @struct fasta_input
+    @brief A FASTA file read by kseq, inflated in parallel if it is BGZF
+
+    Other files, either uncompressed or gzip compressed with one or more members, are read by zlib on the calling
+    thread, since the boundaries of their members can't be known without inflating them.
+*/
+struct fasta_input
+{
+    gzFile gz; /**< File read by zlib, NULL if the file is BGZF */
+    bgzf* bgzf; /**< File inflated in parallel, NULL if the file is not BGZF */
+};
+
+/**
+ *
+ * @brief Return true if and only if a file, gzip compressed or not, starts with a FASTA header
+ */
+bool
+fasta_input_detect(const char*);
+
+/**
+ *
+ * @brief Return an estimate of the uncompressed length of a file, gzip compressed or not
+ */
+uint64_t
+fasta_input_estimate_length(const char*);
+
+/**
+ * @brief Open a FASTA file, BGZF files are inflated by a given number of threads
+ *
+ * @return opened file
+ */
+fasta_input*
+fasta_input_open(const char*, uint64_t);
+
+/**
+ *
+ * @brief Read uncompressed bytes from a FASTA file, return the number of bytes read
+ */
+int
+fasta_input_read(fasta_input*, void*, unsigned);
+
+/**
+ *
+ * @brief Close a FASTA file
+ */
+void
+fasta_input_close(fasta_input*);
+
+#endif
@@ -0,0 +1,162 @@
+#include "mapped.h"
+
+/**
+ * @param filename Name of a FASTA file
+ * @return The mapped file, NULL if the file can't be mapped or doesn't look like uncompressed FASTA
+ */
+mapped_fasta*
+mapped_fasta_open(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    const char* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    // Compressed files and FASTQ are read by kseq
+    if (data[0] != '>')
+    {
+        munmap((void*) data, st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    posix_madvise((void*) data, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    mapped_fasta* m = malloc(sizeof(mapped_fasta));
+    m->fd = fd;
+    m->data = data;
+    m->length = st.st_size;
+
+    return m;
+}
+
+/**
+ * @param m A mapped FASTA file
+ */
+void
+mapped_fasta_close(mapped_fasta* m)
+{
+    assert(m != NULL && "Mapped file is not opened");
+
+    munmap((void*) m->data, m->length);
+    close(m->fd);
+    free(m);
+}
+
+/**
+ *  Return true if the character c of FASTA text is whitespace, which is skipped inside sequences
+ */
+static inline bool
+is_space(char c)
+{
+    return c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+
+/**
+ *  Return the start of the line of p, without looking before limit
+ */
+static const char*
+find_line_start(const char* limit, const char* p)
+{
+    while (p > limit && p[-1] != '\n')
+    {
+        p--;
+    }
+
+    return p;
+}
+
+/**
+ * @param cut Cut to set
+ * @param text Beginning of the FASTA text, which is the beginning of a line
+ * @param end End of the text
+ * @param p Position of the cut
+ * @param bases Number of sequence characters to read before p, k - 1 to read the k-mers ending at p
+ * @param prev A cut of the same text at or before p, NULL to look back as far as the beginning of the text
+ *
+ * Parsing begins bases sequence characters before p, line breaks and whitespace skipped, or at the line following
+ * the header of the record of p if it has fewer bases before p. A cut on a header line is parsed from p
+ */
+void
+mapped_cut_text(mapped_cut* cut, const char* text, const char* end, const char* p, uint64_t bases,
+                const mapped_cut* prev)
+{
+    assert((prev == NULL || prev->p <= p) && "Cuts must be in the order of the text");
+
+    // The line of p begins before the previous cut, so it has the header state of that cut
+    const char* limit = prev != NULL ? prev->p : text;
+    const char* line = find_line_start(limit, p);
+    bool known = line == text || line[-1] == '\n';
+    bool header = known ? line < end && *line == '>' : prev->header;
+
+    cut->p = p;
+    cut->header = header;
+    cut->parse_header = false;
+
+    if (header)
+    {
+        cut->parse = p;
+        cut->line_start = p == line && known;
+        cut->parse_header = !cut->line_start;
+        return;
+    }
+
+    const char* c = p;
+    uint64_t count = 0;
+    while (c > text && count < bases)
+    {
+        // c starts a line, the line before it may be the header of the record of p
+        if (c[-1] == '\n' && *find_line_start(text, c - 1) == '>')
+        {
+            break;
+        }
+
+        c--;
+        count += !is_space(*c);
+    }
+
+    cut->parse = c;
+    cut->line_start = c == text || c[-1] == '\n';
+}
+
+/**
+ * @param cut Set to the cut of the beginning of the slice
+ * @param text Beginning of the FASTA text
+ * @param chunk Cut of the beginning of the chunk
+ * @param length Number of characters of the chunk
+ * @param index Index of the slice
+ * @param count Number of slices
+ * @param bases Number of sequence characters to read before the slice, k - 1 to read the k-mers ending in it
+ * @return The end of the slice
+ *
+ * Slices are cut anywhere, so a record on a single line is split between the slices as a wrapped one is. Parsing
+ * a slice from cut->parse to its end and keeping the k-mers ending at cut->p or after it reads each k-mer of the
+ * chunk in exactly one slice
+ */
+const char*
+mapped_slice(mapped_cut* cut, const char* text, const mapped_cut* chunk, uint64_t length, uint64_t index,
+             uint64_t count, uint64_t bases)
+{
+    uint64_t slice = (length + count - 1) / count;
+    uint64_t begin = index * slice < length ? index * slice : length;
+    uint64_t end = begin + slice < length ? begin + slice : length;
+
+    mapped_cut_text(cut, text, chunk->p + length, chunk->p + begin, bases, chunk);
+
+    return chunk->p + end;
+}
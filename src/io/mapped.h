@@ -0,0 +1,75 @@
+#ifndef HAGUE_MAPPED_H
+#define HAGUE_MAPPED_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct mapped_fasta mapped_fasta;
+
+typedef struct mapped_cut mapped_cut;
+
+/** @struct mapped_fasta
+    @brief An uncompressed FASTA file mapped in memory
+
+    The text is read in place: it can be cut anywhere into chunks that are parsed independently, each one looking
+    back at the end of the previous chunk for the first bases of its k-mers, see mapped_cut.
+*/
+struct mapped_fasta
+{
+    int fd; /**< Descriptor of the file */
+    const char* data; /**< Mapped content of the file */
+    uint64_t length; /**< Number of bytes of the file */
+};
+
+/** @struct mapped_cut
+    @brief A position of FASTA text where a chunk parsed on its own begins
+
+    A chunk may begin inside a line, even inside a header line, so a parser resumes from the state of the text at
+    parse: the k-mers ending at p or after it belong to the chunk, those ending before p to the previous one. The
+    header state of a cut is found by looking back at most to an earlier cut, so records on a single line are cut
+    in time proportional to the chunks rather than to the line.
+*/
+struct mapped_cut
+{
+    const char* p; /**< First character of the chunk */
+    bool header; /**< True if p is on a header line */
+    const char* parse; /**< Character where parsing begins, up to a given number of bases before p in its record */
+    bool line_start; /**< True if parse is at the beginning of a line */
+    bool parse_header; /**< True if parse is inside a header line, after its '>' */
+};
+
+/**
+ *
+ * @brief Map a FASTA file in memory, return NULL if it is compressed, empty or doesn't start with a header
+ */
+mapped_fasta*
+mapped_fasta_open(const char*);
+
+/**
+ *
+ * @brief Unmap and close a FASTA file
+ */
+void
+mapped_fasta_close(mapped_fasta*);
+
+/**
+ *
+ * @brief Cut FASTA text at a given position, looking back a given number of bases and at most to an earlier cut
+ */
+void
+mapped_cut_text(mapped_cut*, const char*, const char*, const char*, uint64_t, const mapped_cut*);
+
+/**
+ *
+ * @brief Cut one of a given number of slices of about the same length out of a chunk of FASTA text, return its end
+ */
+const char*
+mapped_slice(mapped_cut*, const char*, const mapped_cut*, uint64_t, uint64_t, uint64_t, uint64_t);
+
+#endif
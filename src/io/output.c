@@ -0,0 +1,77 @@
+#include "output.h"
+
+/**
+ *  Allocate an output writing to the descriptor fd, closed with the output if owned
+ */
+static output*
+create_output(int fd, bool owned)
+{
+    output* o = malloc(sizeof(output));
+    o->fd = fd;
+    o->owned = owned;
+    o->buffer = malloc(OUTPUT_BUFFER_LENGTH);
+    o->length = 0;
+    assert(o->buffer != NULL && "Could not allocate output buffer");
+
+    return o;
+}
+
+/**
+ * @param filename Name of the output file
+ * @return The opened output, with an empty buffer
+ */
+output*
+output_open(const char* filename)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0 && "Could not open output file");
+
+    return create_output(fd, true);
+}
+
+/**
+ * @return An output writing to the standard output, which is not closed with it
+ */
+output*
+output_open_stdout()
+{
+    fflush(stdout);
+
+    return create_output(STDOUT_FILENO, false);
+}
+
+/**
+ * @param o An opened output
+ */
+void
+output_flush(output* o)
+{
+    uint64_t offset = 0;
+    while (offset < o->length)
+    {
+        ssize_t n = write(o->fd, &o->buffer[offset], o->length - offset);
+        assert(n > 0 && "Could not write output");
+        offset += n;
+    }
+
+    o->length = 0;
+}
+
+/**
+ * @param o An opened output
+ */
+void
+output_close(output* o)
+{
+    assert(o != NULL && "Output is not opened");
+
+    output_flush(o);
+    if (o->owned)
+    {
+        int error = close(o->fd);
+        assert(error == 0 && "Could not write output");
+    }
+
+    free(o->buffer);
+    free(o);
+}
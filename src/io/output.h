@@ -0,0 +1,122 @@
+#ifndef HAGUE_OUTPUT_H
+#define HAGUE_OUTPUT_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Number of bytes buffered by an output before they are written
+ */
+#define OUTPUT_BUFFER_LENGTH ((uint64_t) 1 << 22)
+
+typedef struct output output;
+
+/** @struct output
+    @brief A file written through a large buffer, flushed with a single write call when it is full
+
+    Text is appended by the inline functions below, which format numbers by hand instead of parsing a printf
+    format for every field.
+*/
+struct output
+{
+    int fd; /**< Descriptor of the file */
+    bool owned; /**< True if the descriptor is closed with the output */
+    char* buffer; /**< Bytes not written yet */
+    uint64_t length; /**< Number of bytes of the buffer */
+};
+
+/**
+ *
+ * @brief Create or truncate a file and open it as an output
+ */
+output*
+output_open(const char*);
+
+/**
+ *
+ * @brief Open the standard output as an output, flushing what has already been printed to it
+ */
+output*
+output_open_stdout();
+
+/**
+ *
+ * @brief Write the buffered bytes of an output
+ */
+void
+output_flush(output*);
+
+/**
+ *
+ * @brief Flush an output, then close it
+ */
+void
+output_close(output*);
+
+/**
+ * @brief Append a given number of characters to an output
+ */
+static inline void
+output_write(output* o, const char* s, uint64_t length)
+{
+    if (o->length + length > OUTPUT_BUFFER_LENGTH)
+    {
+        output_flush(o);
+
+        // Longer strings than the buffer, e.g. walks, are written directly
+        if (length > OUTPUT_BUFFER_LENGTH)
+        {
+            uint64_t offset = 0;
+            while (offset < length)
+            {
+                ssize_t n = write(o->fd, &s[offset], length - offset);
+                assert(n > 0 && "Could not write output");
+                offset += n;
+            }
+            return;
+        }
+    }
+
+    memcpy(&o->buffer[o->length], s, length);
+    o->length += length;
+}
+
+/**
+ * @brief Append a character to an output
+ */
+static inline void
+output_char(output* o, char c)
+{
+    if (o->length == OUTPUT_BUFFER_LENGTH)
+    {
+        output_flush(o);
+    }
+
+    o->buffer[o->length++] = c;
+}
+
+/**
+ * @brief Append the decimal notation of an unsigned number to an output
+ */
+static inline void
+output_uint(output* o, uint64_t n)
+{
+    char digits[20];
+    uint64_t i = sizeof(digits);
+
+    do
+    {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n > 0);
+
+    output_write(o, &digits[i], sizeof(digits) - i);
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "pipeline.h"
+
+/**
+ *  Return the current time of a monotonic clock in nanoseconds
+ */
+static uint64_t
+now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ *  Copy the next characters of the FASTA file of pipeline p to batch, after the last characters of the previous
+ *  batch prev if it was full and its record is continued. Return false if there are no more characters
+ */
+static bool
+fill_batch(pipeline* p, pipeline_batch* batch, pipeline_batch* prev, bool* record_pending, uint64_t* record_offset)
+{
+    kseq_t* seq = p->seq;
+    uint64_t carry = 0;
+
+    // prev may be batch itself when the ring has a single buffer, hence the memmove
+    if (prev != NULL && prev->length == p->capacity)
+    {
+        carry = p->overlap;
+        memmove(batch->data, &prev->data[prev->length - carry], carry);
+    }
+    batch->length = carry;
+
+    while (batch->length < p->capacity)
+    {
+        if (!*record_pending)
+        {
+            if (kseq_read(seq) < 0)
+            {
+                break;
+            }
+
+            assert(seq->seq.l >= p->min_record_length &&
+                           "Sequence length must be equal to or greater than k-mer length");
+
+            *record_pending = true;
+            *record_offset = 0;
+
+            // A character that is not a nucleotide, so that no k-mer spans two records
+            if (batch->length > 0)
+            {
+                batch->data[batch->length++] = '\n';
+            }
+        }
+
+        uint64_t n = seq->seq.l - *record_offset;
+        if (n > p->capacity - batch->length)
+        {
+            n = p->capacity - batch->length;
+        }
+
+        memcpy(&batch->data[batch->length], &seq->seq.s[*record_offset], n);
+        batch->length += n;
+        *record_offset += n;
+
+        if (*record_offset == seq->seq.l)
+        {
+            *record_pending = false;
+        }
+    }
+
+    return batch->length > carry;
+}
+
+/**
+ *  Return true if the character c of FASTA text is whitespace, which is skipped inside sequences
+ */
+static inline bool
+is_space(char c)
+{
+    return c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+
+/**
+ *  Write to batch the beginning of a text batch following prev, so that it can be parsed on its own: '>' if
+ *  prev ends inside a header line, otherwise the last overlap bases of the sequence prev ends with, followed by
+ *  a line break
+ */
+static void
+continue_text(pipeline* p, pipeline_batch* batch, pipeline_batch* prev)
+{
+    const char* text = prev->data;
+    uint64_t i = prev->length;
+
+    // Start of the last line of prev
+    uint64_t line = i;
+    while (line > 0 && text[line - 1] != '\n')
+    {
+        line--;
+    }
+
+    if (line < i && text[line] == '>')
+    {
+        batch->data[0] = '>';
+        batch->length = 1;
+        return;
+    }
+
+    // Walk back to the first of the last overlap bases of the record, stopping at its header. prev starts at a
+    // line, so a line starting with '>' is always a header
+    uint64_t bases = 0;
+    while (i > 0 && bases < p->overlap)
+    {
+        if (text[i - 1] == '\n')
+        {
+            line = i - 1;
+            while (line > 0 && text[line - 1] != '\n')
+            {
+                line--;
+            }
+
+            if (text[line] == '>')
+            {
+                break;
+            }
+        }
+
+        i--;
+        bases += !is_space(text[i]);
+    }
+
+    // batch may be prev itself when the ring has a single buffer, bases are copied forward so it doesn't matter
+    uint64_t length = 0;
+    for (; i < prev->length; i++)
+    {
+        if (!is_space(text[i]))
+        {
+            // Anything else than a nucleotide only has to break k-mers, '>' would start a header
+            batch->data[length++] = hkmer_encode_base(text[i]) == HKMER_INVALID_BASE ? 'N' : text[i];
+        }
+    }
+    batch->data[length++] = '\n';
+    batch->length = length;
+}
+
+/**
+ *  Copy the next bytes of the FASTA text of pipeline p to batch, after the beginning needed to continue the
+ *  previous batch prev. Return false if there are no more bytes
+ */
+static bool
+fill_text_batch(pipeline* p, pipeline_batch* batch, pipeline_batch* prev)
+{
+    // prev may be batch itself, so its length is only overwritten by continue_text
+    if (prev != NULL)
+    {
+        continue_text(p, batch, prev);
+    }
+    else
+    {
+        batch->length = 0;
+    }
+
+    uint64_t start = batch->length;
+    while (batch->length < p->capacity)
+    {
+        int n = fasta_input_read(p->input, &batch->data[batch->length], p->capacity - batch->length);
+        if (n <= 0)
+        {
+            break;
+        }
+        batch->length += n;
+    }
+
+    return batch->length > start;
+}
+
+/**
+ *  Body of the reader thread, which fills the free buffers of the ring until the end of the file
+ */
+static void*
+run_reader(void* arg)
+{
+    pipeline* p = arg;
+    pipeline_batch* prev = NULL;
+    bool record_pending = false;
+    uint64_t record_offset = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        if (p->count_read - p->count_released == p->count_buffers)
+        {
+            uint64_t start = now_ns();
+            while (p->count_read - p->count_released == p->count_buffers)
+            {
+                pthread_cond_wait(&p->released, &p->lock);
+            }
+            p->stats.reader_wait_ns += now_ns() - start;
+        }
+        pipeline_batch* batch = &p->buffers[p->count_read % p->count_buffers];
+        pthread_mutex_unlock(&p->lock);
+
+        bool filled = p->text ? fill_text_batch(p, batch, prev)
+                              : fill_batch(p, batch, prev, &record_pending, &record_offset);
+
+        pthread_mutex_lock(&p->lock);
+        if (filled)
+        {
+            p->count_read++;
+            p->stats.count_batches++;
+        }
+        else
+        {
+            p->done = true;
+        }
+        pthread_cond_signal(&p->read);
+        pthread_mutex_unlock(&p->lock);
+
+        if (!filled)
+        {
+            break;
+        }
+        prev = batch;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Allocate a pipeline reading a FASTA file with either a kseq parser or directly, and start its reader thread
+ */
+static pipeline*
+start_pipeline(kseq_t* seq, fasta_input* input, uint64_t capacity, uint64_t overlap, uint64_t min_record_length,
+               uint64_t count_buffers)
+{
+    // A text batch may start with overlap bases and a line break before any new byte
+    assert(capacity > overlap + 1 && "Batch capacity must be greater than the overlap");
+    assert(count_buffers > 0 && "Number of buffers must be greater than 0");
+
+    pipeline* p = malloc(sizeof(pipeline));
+    p->seq = seq;
+    p->input = input;
+    p->text = input != NULL;
+    p->count_buffers = count_buffers;
+    p->buffers = malloc(count_buffers * sizeof(pipeline_batch));
+    p->capacity = capacity;
+    p->overlap = overlap;
+    p->min_record_length = min_record_length;
+    p->count_read = 0;
+    p->count_acquired = 0;
+    p->count_released = 0;
+    p->done = false;
+    memset(&p->stats, 0, sizeof(pipeline_stats));
+
+    for (uint64_t i = 0; i < count_buffers; i++)
+    {
+        p->buffers[i].data = malloc(capacity);
+        p->buffers[i].length = 0;
+        assert(p->buffers[i].data != NULL && "Could not allocate pipeline buffer");
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->read, NULL);
+    pthread_cond_init(&p->released, NULL);
+
+    int error = pthread_create(&p->reader, NULL, run_reader, p);
+    assert(error == 0 && "Could not create reader thread");
+
+    return p;
+}
+
+/**
+ * @param seq A FASTA sequence parsed using kseq library, which must not be used until the pipeline is destroyed
+ * @param capacity The maximum number of characters of a batch, must be greater than overlap + 1
+ * @param overlap The number of characters repeated when a record is continued in the next batch, i.e. k - 1
+ * @param min_record_length The minimum length of a record, i.e. k
+ * @param count_buffers The number of buffers of the ring, must be greater than 0
+ * @return A pipeline in record mode whose reader thread is already running
+ */
+pipeline*
+pipeline_create(kseq_t* seq, uint64_t capacity, uint64_t overlap, uint64_t min_record_length, uint64_t count_buffers)
+{
+    return start_pipeline(seq, NULL, capacity, overlap, min_record_length, count_buffers);
+}
+
+/**
+ * @param input An opened FASTA file, which must not be used until the pipeline is destroyed
+ * @param capacity The maximum number of characters of a batch, must be greater than overlap + 1
+ * @param overlap The number of bases repeated when a sequence is continued in the next batch, i.e. k - 1
+ * @param count_buffers The number of buffers of the ring, must be greater than 0
+ * @return A pipeline in text mode whose reader thread is already running
+ */
+pipeline*
+pipeline_create_text(fasta_input* input, uint64_t capacity, uint64_t overlap, uint64_t count_buffers)
+{
+    return start_pipeline(NULL, input, capacity, overlap, 0, count_buffers);
+}
+
+/**
+ * @param p An initialized pipeline
+ * @return The next batch, which must be given back with pipeline_release, NULL if there are no more batches
+ */
+pipeline_batch*
+pipeline_acquire(pipeline* p)
+{
+    pthread_mutex_lock(&p->lock);
+    if (p->count_acquired == p->count_read && !p->done)
+    {
+        uint64_t start = now_ns();
+        while (p->count_acquired == p->count_read && !p->done)
+        {
+            pthread_cond_wait(&p->read, &p->lock);
+        }
+        p->stats.consumer_wait_ns += now_ns() - start;
+    }
+
+    pipeline_batch* batch = NULL;
+    if (p->count_acquired < p->count_read)
+    {
+        batch = &p->buffers[p->count_acquired % p->count_buffers];
+        p->count_acquired++;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return batch;
+}
+
+/**
+ * @param p An initialized pipeline
+ * @param batch The oldest batch acquired and not released yet
+ */
+void
+pipeline_release(pipeline* p, pipeline_batch* batch)
+{
+    pthread_mutex_lock(&p->lock);
+    assert(batch == &p->buffers[p->count_released % p->count_buffers] && "Batches must be released in order");
+    p->count_released++;
+    pthread_cond_signal(&p->released);
+    pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * @param p An initialized pipeline whose batches have all been acquired and released
+ */
+void
+pipeline_destroy(pipeline* p)
+{
+    assert(p != NULL && "Pipeline is not initialized");
+
+    pthread_join(p->reader, NULL);
+
+    for (uint64_t i = 0; i < p->count_buffers; i++)
+    {
+        free(p->buffers[i].data);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->read);
+    pthread_cond_destroy(&p->released);
+    free(p->buffers);
+    free(p);
+}
@@ -0,0 +1,118 @@
+#ifndef HAGUE_PIPELINE_H
+#define HAGUE_PIPELINE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <zlib.h>
+#include "utils/initializer.h"
+#include "klib/kseq.h"
+#include "io/input.h"
+#include "graph/hkmer.h"
+
+typedef struct pipeline pipeline;
+
+typedef struct pipeline_batch pipeline_batch;
+
+typedef struct pipeline_stats pipeline_stats;
+
+/** @struct pipeline_batch
+    @brief A buffer filled by the reader thread of a pipeline
+
+    In record mode a batch holds bare sequences separated by a character which is not a nucleotide. A record that
+    doesn't fit is continued in the next batch, which then starts with the last overlap characters of this one,
+    so that every k-mer of the record is entirely contained in one of the two batches.
+
+    In text mode a batch holds FASTA text, cut anywhere. A batch continuing a sequence starts with a line holding
+    the last overlap bases of that sequence, a batch continuing a header line starts with '>', so every batch
+    can be parsed on its own from its beginning.
+*/
+struct pipeline_batch
+{
+    char* data; /**< Characters of the batch */
+    uint64_t length; /**< Number of characters of the batch */
+};
+
+/** @struct pipeline_stats
+    @brief Time spent by each side of a pipeline waiting on the other one
+*/
+struct pipeline_stats
+{
+    uint64_t count_batches; /**< Number of batches read */
+    uint64_t reader_wait_ns; /**< Time spent by the reader waiting for a free buffer, i.e. consumers are slower */
+    uint64_t consumer_wait_ns; /**< Time spent by the consumer waiting for a batch, i.e. the reader is slower */
+};
+
+/** @struct pipeline
+    @brief Sequences of a FASTA file read by a dedicated thread into a bounded ring of reusable batches
+
+    The reader thread decompresses the file and copies it to the next free buffer of the ring, while the
+    consumer processes the batches already read, so reading and consuming overlap. Batches are consumed and
+    released in the order they are read.
+
+    Records are either parsed by kseq, which holds a whole record in memory, or streamed as text, in which case
+    memory doesn't depend on the length of the records.
+*/
+struct pipeline
+{
+    kseq_t* seq; /**< Parser of the FASTA file in record mode, used by the reader thread only */
+    fasta_input* input; /**< FASTA file in text mode, used by the reader thread only */
+    bool text; /**< True if batches hold FASTA text, false if they hold bare sequences */
+    uint64_t count_buffers; /**< Number of buffers of the ring */
+    pipeline_batch* buffers; /**< Ring of buffers */
+    uint64_t capacity; /**< Maximum number of characters of a batch */
+    uint64_t overlap; /**< Number of characters repeated at the beginning of a batch continuing a record */
+    uint64_t min_record_length; /**< Minimum length of a record */
+    uint64_t count_read; /**< Number of batches read so far */
+    uint64_t count_acquired; /**< Number of batches acquired by the consumer so far */
+    uint64_t count_released; /**< Number of batches released by the consumer so far */
+    bool done; /**< Set by the reader thread when the whole file has been read */
+    pipeline_stats stats; /**< Stalls of the reader and of the consumer */
+    pthread_t reader; /**< Reader thread */
+    pthread_mutex_t lock; /**< Protects the counters, the flag and the statistics */
+    pthread_cond_t read; /**< Signaled when a batch has been read */
+    pthread_cond_t released; /**< Signaled when a batch has been released */
+};
+
+/**
+ * @brief Start reading a FASTA sequence into a ring of a given number of batches of a given capacity
+ *
+ * @return started pipeline
+ */
+pipeline*
+pipeline_create(kseq_t*, uint64_t, uint64_t, uint64_t, uint64_t);
+
+/**
+ * @brief Start streaming the text of a FASTA file into a ring of a given number of batches of a given capacity
+ *
+ * @return started pipeline
+ */
+pipeline*
+pipeline_create_text(fasta_input*, uint64_t, uint64_t, uint64_t);
+
+/**
+ *
+ * @brief Return the next batch of a pipeline, waiting for it to be read, NULL if the whole file has been read
+ */
+pipeline_batch*
+pipeline_acquire(pipeline*);
+
+/**
+ *
+ * @brief Give back the oldest acquired batch of a pipeline, so that its buffer can be reused
+ */
+void
+pipeline_release(pipeline*, pipeline_batch*);
+
+/**
+ *
+ * @brief Wait for the reader thread of a pipeline to finish, then destroy the pipeline
+ */
+void
+pipeline_destroy(pipeline*);
+
+#endif
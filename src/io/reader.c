@@ -1,10 +1,9 @@
 #include "reader.h"
 
 kseq_t*
-read_fasta(char* filename, gzFile* fp)
+read_fasta(char* filename, uint64_t threads, fasta_input** fp)
 {
-    *fp = gzopen(filename, "r");
-    assert(*fp != NULL && "Could not open fasta file");
+    *fp = fasta_input_open(filename, threads);
     kseq_t* seq = kseq_init(*fp);
 
     return seq;
@@ -2,16 +2,18 @@
 #define HAGUE_READER_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <zlib.h>
 #include "utils/initializer.h"
 #include "klib/kseq.h"
+#include "io/input.h"
 
 /**
- * @brief Read FASTA file(gz compressed or uncompressed)
+ * @brief Read FASTA file(gz compressed or uncompressed), BGZF files are inflated by a given number of threads
  *
  * @return kseq_t structure with name, comment, sequence and quality fields.
  */
 kseq_t*
-read_fasta(char*, gzFile*);
+read_fasta(char*, uint64_t, fasta_input**);
 
 #endif
@@ -10,9 +10,141 @@
 #include "io/reader.h"
 #include "cmdline/cmdline.h"
 #include "graph/hgraph.h"
+#include "graph/hunitig.h"
+#include "graph/hstore.h"
+#include "graph/himage.h"
+#include "graph/hexport.h"
 
 typedef struct gengetopt_args_info ggo_args;
 
+/**
+ *  Return the descriptor of the file an eulerian walk is written to while it is computed, the console if filename
+ *  is NULL
+ */
+static int
+open_walk(const char* filename)
+{
+    if (!filename)
+    {
+        fflush(stdout);
+        return STDOUT_FILENO;
+    }
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0 && "Could not open output file");
+
+    return fd;
+}
+
+/**
+ *  Close the file fd opened by open_walk for filename. If the walk hasn't been written because the edges of the
+ *  graph can't be covered by a single walk, no file is left. Return connected
+ */
+static bool
+close_walk(int fd, const char* filename, bool connected)
+{
+    if (!filename)
+    {
+        return connected;
+    }
+
+    close(fd);
+
+    if (!connected)
+    {
+        remove(filename);
+    }
+
+    return connected;
+}
+
+/**
+ *  Compact graph g into unitigs, then export the compacted graph or write its eulerian walk as requested by ai.
+ *  Return the exit code of the program
+ */
+static uint8_t
+run_unitigs(hgraph* g, ggo_args* ai)
+{
+    uint8_t result_code = EXIT_SUCCESS;
+
+    hunitig_graph* u = hunitig_compact(g, ai->threads_arg);
+    hgraph_destroy(g);
+
+#ifdef DEBUG
+    printf("Nodes: %lu\nUnitigs: %lu\n", u->count_nodes, u->count_unitigs);
+#endif
+
+    if (!ai->output_walk_given)
+    {
+        if (ai->output_file_arg)
+        {
+            hunitig_export_to_file(u, ai->output_file_arg, ai->weighted_given);
+        }
+        else
+        {
+            hunitig_print_graph(u, ai->weighted_given);
+        }
+    }
+    else
+    {
+        int fd = open_walk(ai->output_file_arg);
+        if (!close_walk(fd, ai->output_file_arg, hunitig_export_eulerian_walk(u, fd)))
+        {
+#ifdef DEBUG
+            printf("No eulerian walk");
+#endif
+            result_code = EXIT_FAILURE;
+        }
+    }
+
+    hunitig_destroy(u);
+
+    return result_code;
+}
+
+/**
+ *  Export the graph image requested by ai or write its eulerian walk. Return the exit code of the program
+ */
+static uint8_t
+run_image(ggo_args* ai)
+{
+    assert(!ai->unitigs_given && "Unitigs need a graph, not an image");
+
+    uint8_t result_code = EXIT_SUCCESS;
+    himage* img = himage_open(ai->image_arg);
+
+#ifdef DEBUG
+    printf("Vertices: %lu\nEdges: %lu\n", img->count_vertices, img->count_edges);
+#endif
+
+    if (!ai->output_walk_given)
+    {
+        if (ai->output_file_arg)
+        {
+            himage_export_to_file(img, ai->output_file_arg, ai->weighted_given);
+        }
+        else
+        {
+            himage_print_graph(img, ai->weighted_given);
+        }
+    }
+    else
+    {
+        int fd = open_walk(ai->output_file_arg);
+        if (!close_walk(fd, ai->output_file_arg, himage_export_eulerian_walk(img, fd)))
+        {
+#ifdef DEBUG
+            printf("No eulerian walk");
+#endif
+            result_code = EXIT_FAILURE;
+        }
+    }
+
+    himage_close(img);
+
+    return result_code;
+}
+
 uint8_t
 main(uint64_t argc, char** argv)
 {
@@ -22,26 +154,117 @@ main(uint64_t argc, char** argv)
     ggo_args ai;
     assert(cmdline_parser(argc, argv, &ai) == 0);
 
-    assert(ai.k_mer_length_arg > 1 && "k-mer length must be greater than 1");
+    bool saved = ai.load_graph_given || ai.image_given;
+    assert((ai.filename_given || saved) && "A FASTA file or a saved graph is required");
+    assert((saved || ai.k_mer_length_arg > 1) && "k-mer length must be greater than 1");
+    assert(ai.threads_arg > 0 && "Number of threads must be greater than 0");
+    assert(ai.min_count_arg > 0 && "Minimum count must be greater than 0");
+    assert(!(ai.max_memory_given && ai.max_memory_arg <= 0) && "Memory budget must be greater than 0");
+    assert(!(ai.canonical_given && ai.output_walk_given) && "Eulerian walks need a graph of the forward strand");
+    assert(!(ai.canonical_given && ai.unitigs_given) && "Unitigs need a graph of the forward strand");
+    assert(!(ai.canonical_given && ai.save_image_given) && "Graph images need a graph of the forward strand");
+    assert(!(ai.split_output_given && !ai.output_file_given) && "Split output needs an output file");
+    assert(!(ai.id_tables_given && !ai.output_file_given) && "Integer ID tables need an output file");
+    assert(!(ai.id_tables_given && (ai.canonical_given || ai.unitigs_given || ai.image_given))
+           && "Integer ID tables need a graph of the forward strand, neither compacted nor mapped");
 
-    gzFile fp;
-    kseq_t* seq = read_fasta(ai.filename_arg, &fp);
+    // An image is used in place, the graph is neither built nor loaded
+    if (ai.image_given)
+    {
+        result_code = run_image(&ai);
+        cmdline_parser_free(&ai);
 
-    hgraph* g = hgraph_create_de_bruijn_graph(seq, ai.k_mer_length_arg);
+        return result_code;
+    }
+
+    hgraph_build_options options;
+    hgraph_build_options_init(&options, ai.k_mer_length_arg);
+    options.threads = ai.threads_arg;
+    options.min_count = ai.min_count_arg;
+    options.canonical = ai.canonical_given;
+    options.sort = ai.sort_given || ai.max_memory_given;
+    options.max_memory = ai.max_memory_given ? (uint64_t) ai.max_memory_arg << 20 : 0;
+
+    // If the edges table is the only output, it is written while k-mers are counted and the graph is never built
+    bool stream = ai.max_memory_given && !ai.load_graph_given && !ai.output_walk_given && !ai.unitigs_given
+                  && !ai.save_graph_given && !ai.save_image_given && !ai.id_tables_given && !ai.split_output_given;
+    if (stream)
+    {
+        options.stream = ai.output_file_given ? output_open(ai.output_file_arg) : output_open_stdout();
+        options.weighted = ai.weighted_given;
+    }
+
+#ifdef DEBUG
+    pipeline_stats stats = { 0 };
+    options.stats = &stats;
+#endif
+
+    hgraph* g = ai.load_graph_given ? hgraph_load(ai.load_graph_arg, ai.threads_arg)
+                                    : hgraph_create_de_bruijn_graph_from_file(ai.filename_arg, &options);
 
 #ifdef DEBUG
     printf("Vertices: %d\nEdges: %d\n", hgraph_vertex_count(g), hgraph_edge_count(g));
+    printf("Batches: %lu\nReader stalled: %.3f s\nInsertion stalled: %.3f s\n", stats.count_batches,
+           stats.reader_wait_ns / 1e9, stats.consumer_wait_ns / 1e9);
 #endif
 
+    if (stream)
+    {
+        output_close(options.stream);
+        hgraph_destroy(g);
+        cmdline_parser_free(&ai);
+
+        return result_code;
+    }
+
+    if (ai.save_graph_given)
+    {
+        hgraph_save(g, ai.save_graph_arg);
+    }
+
+    if (ai.save_image_given)
+    {
+        himage_save(g, ai.save_image_arg);
+    }
+
+    if (ai.save_graph_given || ai.save_image_given)
+    {
+        // Saving the graph is the only output, unless another one is requested
+        if (!ai.output_walk_given && !ai.output_file_given && !ai.unitigs_given)
+        {
+            hgraph_destroy(g);
+            cmdline_parser_free(&ai);
+
+            return result_code;
+        }
+    }
+
+    if (ai.unitigs_given)
+    {
+        result_code = run_unitigs(g, &ai);
+        cmdline_parser_free(&ai);
+
+        return result_code;
+    }
+
     if(!ai.output_walk_given)
     {
-        if(ai.output_file_arg)
+        if (ai.id_tables_given)
+        {
+            hexport_tables(g, ai.output_file_arg, strcmp(ai.id_tables_arg, "binary") == 0);
+        }
+        else if (ai.split_output_given)
         {
-            hgraph_export_to_file(g, ai.output_file_arg);
+            // One file for each thread, each thread writing its own part of the vertices
+            hgraph_export_to_files(g, ai.output_file_arg, ai.weighted_given, ai.threads_arg);
+        }
+        else if(ai.output_file_arg)
+        {
+            hgraph_export_to_file(g, ai.output_file_arg, ai.weighted_given);
         }
         else
         {
-            hgraph_print_graph(g);
+            hgraph_print_graph(g, ai.weighted_given);
         }
     }
     else
@@ -51,31 +274,33 @@ main(uint64_t argc, char** argv)
         if (hgraph_has_eulerian_properties(g))
         {
 #ifdef DEBUG
-            hgraph_vertex* s = hgraph_eulerian_walk_start(g);
-            hgraph_vertex* e = hgraph_eulerian_walk_end(g);
-
             if (hgraph_has_eulerian_cycle(g))
                 printf("Eulerian cycle, picking arbitrary starting vertex\n");
 
             if (hgraph_has_eulerian_path(g))
                 printf("Eulerian path\n");
 
-            printf("Start: %s\nEnd: %s\n", s->key, e->key);
-#endif
-            char* superstring = hgraph_compute_eulerian_walk(g);
-            if(ai.output_file_arg)
-            {
-                FILE *f = fopen(ai.output_file_arg, "w");
+            // A loaded graph has no k-mer length argument, keys are decoded with the length of the graph
+            char* s_key = malloc(g->k * sizeof(char));
+            char* e_key = malloc(g->k * sizeof(char));
+            hkmer_decode(g->walk_start_key, g->k - 1, s_key);
+            hkmer_decode(g->walk_end_key, g->k - 1, e_key);
+            s_key[g->k - 1] = '\0';
+            e_key[g->k - 1] = '\0';
 
-                fprintf(f, "%s", superstring);
-                fclose(f);
-            }
-            else
+            printf("Start: %s\nEnd: %s\n", s_key, e_key);
+
+            free(s_key);
+            free(e_key);
+#endif
+            int fd = open_walk(ai.output_file_arg);
+            if (!close_walk(fd, ai.output_file_arg, hgraph_export_eulerian_walk(g, fd)))
             {
-                printf("%s", superstring);
+#ifdef DEBUG
+                printf("Graph is not connected");
+#endif
+                result_code = EXIT_FAILURE;
             }
-
-            free(superstring);
         }
         else
         {
@@ -87,8 +312,6 @@ main(uint64_t argc, char** argv)
     }
 
     hgraph_destroy(g);
-    kseq_destroy(seq);
-    gzclose(fp);
     cmdline_parser_free(&ai);
 
     return result_code;
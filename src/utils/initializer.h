@@ -3,7 +3,8 @@
 
 #include <zlib.h>
 #include "klib/kseq.h"
+#include "io/input.h"
 
-KSEQ_INIT(gzFile, gzread)
+KSEQ_INIT(fasta_input*, fasta_input_read)
 
 #endif